@@ -0,0 +1,135 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// Bloom over a mip pyramid, in the style of the progressive downsample/upsample filters from
+// Call of Duty: Advanced Warfare.
+//
+// The HDR scene is filtered down a chain of half resolution levels, starting at half the screen:
+// every level is a 13-tap downsample of the one above it (bloom_down.fs). The first step also
+// applies the bright pass threshold (the BLOOM_PREFILTER variant) and weighs its samples against
+// fireflies, so the scene pass doesn't need a second render target for the bright parts. Then the
+// chain is walked back up, every level tent filtered (bloom_up.fs) and added onto the next larger
+// one. texture() ends up holding the sum of all levels at half resolution, a wide glow for a few
+// passes over small targets instead of full screen Gaussian passes.
+//
+// Levels are R11F_G11F_B10F, a bloom has no use for alpha and the 32-bit format halves the bandwidth.
+class MipBloom
+{
+public:
+    static const unsigned int MAX_LEVELS = 6;
+
+    // width and height of the HDR scene, levels stops early once a level would get smaller than 8 pixels
+    MipBloom(unsigned int width, unsigned int height, unsigned int levels = MAX_LEVELS)
+    {
+        unsigned int levelWidth = width / 2, levelHeight = height / 2;
+        for (unsigned int i = 0; i < std::min(levels, MAX_LEVELS) && levelWidth >= 8 && levelHeight >= 8; i++)
+        {
+            Level level;
+            level.width = levelWidth;
+            level.height = levelHeight;
+            glGenTextures(1, &level.texture);
+            glState().bindTexture(0, GL_TEXTURE_2D, level.texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, levelWidth, levelHeight, 0, GL_RGB, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            // the filters reach past the border, clamping keeps them from wrapping around
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+            glGenFramebuffers(1, &level.framebuffer);
+            glState().bindFramebuffer(level.framebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, level.texture, 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                cout << "ERROR::BLOOM:: Framebuffer of level " << i << " not complete" << endl;
+            mips.push_back(level);
+
+            levelWidth /= 2;
+            levelHeight /= 2;
+        }
+        glState().bindFramebuffer(0);
+    }
+
+    ~MipBloom()
+    {
+        for (const Level &level : mips) {
+            glDeleteFramebuffers(1, &level.framebuffer);
+            glState().deleteTexture(level.texture);
+        }
+    }
+
+    MipBloom(const MipBloom &) = delete;
+    MipBloom &operator=(const MipBloom &) = delete;
+
+    // filters the HDR scene in source into texture(). downsample is bloom_down.fs, whose
+    // BLOOM_PREFILTER variant takes the bright parts over threshold, upsample is bloom_up.fs.
+    // drawQuad draws a screen filling quad. Leaves framebuffer 0 bound.
+    void render(unsigned int source, ShaderVariants &downsample, Shader &upsample, float threshold, void (*drawQuad)())
+    {
+        static constexpr UniformId SOURCE("source");
+        static constexpr UniformId THRESHOLD("threshold");
+        if (mips.empty())
+            return;
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        // down the chain, the first step from the scene through the bright pass
+        for (unsigned int i = 0; i < mips.size(); i++)
+        {
+            Shader &shader = downsample.get(i == 0 ? (uint32_t) FEATURE_BLOOM_PREFILTER : 0u);
+            shader.use();
+            shader.setInt(SOURCE, 0);
+            shader.setFloat(THRESHOLD, threshold);
+            glState().bindTexture(0, GL_TEXTURE_2D, i == 0 ? source : mips[i - 1].texture);
+            target(mips[i]);
+            drawQuad();
+        }
+
+        // and back up, every level added onto the larger one above it
+        upsample.use();
+        upsample.setInt(SOURCE, 0);
+        glState().setBlend(true);
+        glState().blendFunc(GL_ONE, GL_ONE);
+        for (unsigned int i = (unsigned int) mips.size() - 1; i > 0; i--)
+        {
+            glState().bindTexture(0, GL_TEXTURE_2D, mips[i].texture);
+            target(mips[i - 1]);
+            drawQuad();
+        }
+        glState().setBlend(false);
+
+        glState().bindFramebuffer(0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // the glow at half the scene's resolution, valid after render()
+    unsigned int texture() const { return mips.empty() ? 0 : mips[0].texture; }
+
+    unsigned int levelCount() const { return (unsigned int) mips.size(); }
+
+private:
+    struct Level {
+        unsigned int framebuffer;
+        unsigned int texture;
+        unsigned int width, height;
+    };
+
+    vector<Level> mips;
+
+    static void target(const Level &level)
+    {
+        glState().bindFramebuffer(level.framebuffer);
+        glViewport(0, 0, level.width, level.height);
+    }
+};
+#endif
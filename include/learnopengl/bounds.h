@@ -0,0 +1,132 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// Object space bounding box and bounding sphere of a mesh. Plain old data, stored as-is in the mesh cache.
+struct MeshBounds {
+    float minimum[3];
+    float maximum[3];
+    float center[3];    // sphere center, the middle of the box
+    float radius;
+
+    MeshBounds()
+    {
+        for (int i = 0; i < 3; i++)
+            minimum[i] = maximum[i] = center[i] = 0.0f;
+        radius = 0.0f;
+    }
+
+    glm::vec3 boxCenter() const
+    {
+        return 0.5f * (glm::vec3(minimum[0], minimum[1], minimum[2]) + glm::vec3(maximum[0], maximum[1], maximum[2]));
+    }
+
+    glm::vec3 boxExtent() const
+    {
+        return 0.5f * (glm::vec3(maximum[0], maximum[1], maximum[2]) - glm::vec3(minimum[0], minimum[1], minimum[2]));
+    }
+};
+
+// Axis aligned box for scene level bounds and queries. Default constructed it is empty, merging
+// into an empty box gives the other box.
+struct Aabb {
+    glm::vec3 minimum;
+    glm::vec3 maximum;
+
+    Aabb() : minimum(FLT_MAX), maximum(-FLT_MAX) {}
+    Aabb(glm::vec3 minimum, glm::vec3 maximum) : minimum(minimum), maximum(maximum) {}
+    explicit Aabb(const MeshBounds &bounds)
+        : minimum(bounds.minimum[0], bounds.minimum[1], bounds.minimum[2]),
+          maximum(bounds.maximum[0], bounds.maximum[1], bounds.maximum[2]) {}
+
+    bool empty() const { return minimum.x > maximum.x; }
+    glm::vec3 center() const { return 0.5f * (minimum + maximum); }
+    glm::vec3 extent() const { return 0.5f * (maximum - minimum); }
+
+    void merge(const Aabb &other)
+    {
+        minimum = glm::min(minimum, other.minimum);
+        maximum = glm::max(maximum, other.maximum);
+    }
+
+    bool overlaps(const Aabb &other) const
+    {
+        return minimum.x <= other.maximum.x && maximum.x >= other.minimum.x &&
+               minimum.y <= other.maximum.y && maximum.y >= other.minimum.y &&
+               minimum.z <= other.maximum.z && maximum.z >= other.minimum.z;
+    }
+
+    bool operator==(const Aabb &other) const { return minimum == other.minimum && maximum == other.maximum; }
+    bool operator!=(const Aabb &other) const { return !(*this == other); }
+
+    // squared distance from point to the box, 0 inside
+    float distanceSquared(glm::vec3 point) const
+    {
+        glm::vec3 outside = glm::max(minimum - point, glm::max(point - maximum, glm::vec3(0.0f)));
+        return glm::dot(outside, outside);
+    }
+
+    // box around this box moved by transform
+    Aabb transformed(const glm::mat4 &transform) const
+    {
+        if (empty())
+            return *this;
+        glm::vec3 center = glm::vec3(transform * glm::vec4(this->center(), 1.0f));
+        glm::vec3 local = extent();
+        glm::vec3 world;
+        for (int row = 0; row < 3; row++)
+            world[row] = std::fabs(transform[0][row]) * local.x + std::fabs(transform[1][row]) * local.y + std::fabs(transform[2][row]) * local.z;
+        return Aabb(center - world, center + world);
+    }
+
+    // slab test, distance is where the ray enters the box (0 if it starts inside)
+    bool intersectRay(glm::vec3 origin, glm::vec3 inverseDirection, float maxDistance, float &distance) const
+    {
+        float enter = 0.0f, exit = maxDistance;
+        for (int axis = 0; axis < 3; axis++) {
+            float t0 = (minimum[axis] - origin[axis]) * inverseDirection[axis];
+            float t1 = (maximum[axis] - origin[axis]) * inverseDirection[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+        }
+        distance = enter;
+        return enter <= exit;
+    }
+};
+
+// box over all positions; the sphere is centered on the box and grown to the farthest vertex,
+// which always encloses the mesh and is within a few percent of the minimal sphere for our models
+inline MeshBounds computeMeshBounds(const vector<Vertex> &vertices)
+{
+    MeshBounds bounds;
+    if (vertices.empty())
+        return bounds;
+    glm::vec3 minimum = vertices[0].Position, maximum = vertices[0].Position;
+    for (const Vertex &vertex : vertices) {
+        minimum = glm::min(minimum, vertex.Position);
+        maximum = glm::max(maximum, vertex.Position);
+    }
+    glm::vec3 center = 0.5f * (minimum + maximum);
+    float radiusSquared = 0.0f;
+    for (const Vertex &vertex : vertices) {
+        glm::vec3 offset = vertex.Position - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    for (int i = 0; i < 3; i++) {
+        bounds.minimum[i] = minimum[i];
+        bounds.maximum[i] = maximum[i];
+        bounds.center[i] = center[i];
+    }
+    bounds.radius = std::sqrt(radiusSquared);
+    return bounds;
+}
+#endif
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <cstdlib>
+#include <vector>
+#include <unistd.h>
 #include "root_directory.h" // This is a configuration file generated by CMake.
 
 class FileSystem
@@ -17,6 +19,40 @@ public:
     return (*pathBuilder)(path);
   }
 
+  // absolute path with "." and ".." resolved and repeated slashes collapsed, so two spellings
+  // of the same file compare equal. Purely lexical, the file doesn't have to exist.
+  static std::string normalize(const std::string& path)
+  {
+    std::string absolute = path;
+    if (path.empty() || path[0] != '/')
+    {
+      char cwd[4096];
+      if (getcwd(cwd, sizeof(cwd)) != nullptr)
+        absolute = std::string(cwd) + "/" + path;
+    }
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= absolute.size())
+    {
+      size_t end = absolute.find('/', start);
+      if (end == std::string::npos)
+        end = absolute.size();
+      std::string part = absolute.substr(start, end - start);
+      if (part == "..")
+      {
+        if (!parts.empty())
+          parts.pop_back();
+      }
+      else if (!part.empty() && part != ".")
+        parts.push_back(part);
+      start = end + 1;
+    }
+    std::string result;
+    for (const std::string& part : parts)
+      result += "/" + part;
+    return result.empty() ? "/" : result;
+  }
+
 private:
   static std::string const & getRoot()
   {
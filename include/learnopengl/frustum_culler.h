@@ -0,0 +1,175 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_CULLER_SSE 1
+#endif
+using namespace std;
+
+// Tests world space bounding boxes against the view frustum, four boxes per iteration.
+//
+// The boxes are kept as structure of arrays (centers and half extents), so one SSE register holds
+// the same coordinate of four boxes and every plane is tested against all four at once.
+// Per frame: begin() with projection * view. Per batch: clear(), add() the boxes, cull(),
+// then read visible(i). stats() counts every box tested since begin().
+class FrustumCuller
+{
+public:
+    struct Stats {
+        unsigned int tested;
+        unsigned int visible;
+
+        unsigned int culled() const { return tested - visible; }
+    };
+
+    enum Containment {
+        OUTSIDE,
+        INTERSECTING,
+        INSIDE
+    };
+
+    static const unsigned int ALL_PLANES = 0x3f;
+
+    FrustumCuller()
+    {
+        frameStats.tested = frameStats.visible = 0;
+        begin(glm::mat4(1.0f));
+    }
+
+    // extracts the six planes from the clip matrix (Gribb/Hartmann), normals point inwards
+    void begin(const glm::mat4 &viewProjection)
+    {
+        const glm::mat4 &m = viewProjection;
+        for (int i = 0; i < 3; i++) {
+            for (int k = 0; k < 4; k++) {
+                planes[2 * i][k] = m[k][3] + m[k][i];       // left, bottom, near
+                planes[2 * i + 1][k] = m[k][3] - m[k][i];   // right, top, far
+            }
+        }
+        for (int p = 0; p < 6; p++) {
+            float length = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+            if (length > 0.0f)
+                for (int k = 0; k < 4; k++)
+                    planes[p][k] /= length;
+        }
+        frameStats.tested = frameStats.visible = 0;
+    }
+
+    void clear()
+    {
+        centerX.clear(); centerY.clear(); centerZ.clear();
+        extentX.clear(); extentY.clear(); extentZ.clear();
+        visibility.clear();
+    }
+
+    // queues the box of bounds moved by transform, returns its index for visible()
+    unsigned int add(const glm::mat4 &transform, const MeshBounds &bounds)
+    {
+        glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.boxCenter(), 1.0f));
+        // the box around the transformed box: every world axis gets the absolute contribution of each local one
+        glm::vec3 local = bounds.boxExtent();
+        glm::vec3 extent;
+        for (int row = 0; row < 3; row++)
+            extent[row] = std::fabs(transform[0][row]) * local.x + std::fabs(transform[1][row]) * local.y + std::fabs(transform[2][row]) * local.z;
+        centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+        extentX.push_back(extent.x); extentY.push_back(extent.y); extentZ.push_back(extent.z);
+        return (unsigned int) centerX.size() - 1;
+    }
+
+    // tests every box added since clear()
+    void cull()
+    {
+        size_t count = centerX.size();
+        // pad to whole groups of four, the extra lanes are never read back
+        size_t padded = (count + 3) & ~(size_t) 3;
+        for (vector<float> *column : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+            column->resize(padded, 0.0f);
+        visibility.assign(padded, 0);
+
+#ifdef FRUSTUM_CULLER_SSE
+        __m128 normalX[6], normalY[6], normalZ[6], distance[6], absX[6], absY[6], absZ[6];
+        for (int p = 0; p < 6; p++) {
+            normalX[p] = _mm_set1_ps(planes[p][0]);
+            normalY[p] = _mm_set1_ps(planes[p][1]);
+            normalZ[p] = _mm_set1_ps(planes[p][2]);
+            distance[p] = _mm_set1_ps(planes[p][3]);
+            absX[p] = _mm_set1_ps(std::fabs(planes[p][0]));
+            absY[p] = _mm_set1_ps(std::fabs(planes[p][1]));
+            absZ[p] = _mm_set1_ps(std::fabs(planes[p][2]));
+        }
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t i = 0; i < padded; i += 4) {
+            __m128 cx = _mm_loadu_ps(&centerX[i]), cy = _mm_loadu_ps(&centerY[i]), cz = _mm_loadu_ps(&centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&extentX[i]), ey = _mm_loadu_ps(&extentY[i]), ez = _mm_loadu_ps(&extentZ[i]);
+            __m128 inside = _mm_cmpeq_ps(zero, zero);
+            for (int p = 0; p < 6; p++) {
+                // signed distance of the center plus the box's projected radius onto the normal
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX[p], cx), _mm_mul_ps(normalY[p], cy)),
+                                      _mm_add_ps(_mm_mul_ps(normalZ[p], cz), distance[p]));
+                __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+            }
+            int mask = _mm_movemask_ps(inside);
+            for (int lane = 0; lane < 4; lane++)
+                visibility[i + lane] = (uint8_t) ((mask >> lane) & 1);
+        }
+#else
+        for (size_t i = 0; i < padded; i++) {
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++) {
+                float d = planes[p][0] * centerX[i] + planes[p][1] * centerY[i] + planes[p][2] * centerZ[i] + planes[p][3];
+                float r = std::fabs(planes[p][0]) * extentX[i] + std::fabs(planes[p][1]) * extentY[i] + std::fabs(planes[p][2]) * extentZ[i];
+                inside = d + r >= 0.0f;
+            }
+            visibility[i] = inside;
+        }
+#endif
+        for (vector<float> *column : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+            column->resize(count);
+        frameStats.tested += (unsigned int) count;
+        for (size_t i = 0; i < count; i++)
+            frameStats.visible += visibility[i];
+    }
+
+    // single box test for hierarchies. planeMask has a bit per plane the box may still cross; planes the
+    // box turns out to be fully inside of are cleared, so the children of a node skip them. A box left
+    // with an empty mask is INSIDE and its whole subtree needs no more tests.
+    Containment classify(const Aabb &box, unsigned int &planeMask) const
+    {
+        glm::vec3 center = box.center(), extent = box.extent();
+        for (int p = 0; p < 6; p++) {
+            if (!(planeMask & (1u << p)))
+                continue;
+            float d = planes[p][0] * center.x + planes[p][1] * center.y + planes[p][2] * center.z + planes[p][3];
+            float r = std::fabs(planes[p][0]) * extent.x + std::fabs(planes[p][1]) * extent.y + std::fabs(planes[p][2]) * extent.z;
+            if (d + r < 0.0f)
+                return OUTSIDE;
+            if (d - r >= 0.0f)
+                planeMask &= ~(1u << p);
+        }
+        return planeMask ? INTERSECTING : INSIDE;
+    }
+
+    bool visible(unsigned int i) const { return visibility[i] != 0; }
+    // world space center of box i
+    glm::vec3 center(unsigned int i) const { return glm::vec3(centerX[i], centerY[i], centerZ[i]); }
+
+    const Stats &stats() const { return frameStats; }
+
+private:
+    float planes[6][4];
+    vector<float> centerX, centerY, centerZ;
+    vector<float> extentX, extentY, extentZ;
+    vector<uint8_t> visibility;
+    Stats frameStats;
+};
+#endif
@@ -0,0 +1,249 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// Shadow copy of the GL state the renderer touches: program, VAO, texture units, framebuffer,
+// depth/cull/blend state. Every bind goes through here and calls that would set what is already
+// set never reach the driver, so draw code can simply ask for the state it needs instead of
+// binding and then resetting everything to defaults.
+//
+// Only valid as long as nobody changes this state behind its back. Code that has to (third party
+// renderers that don't restore what they touch) calls invalidate() afterwards. Deleting a bound
+// object silently rebinds 0, so objects tracked here are deleted through the delete* helpers.
+class GLStateCache
+{
+public:
+    enum Category {
+        PROGRAM,
+        VERTEX_ARRAY,
+        TEXTURE,
+        FRAMEBUFFER,
+        DEPTH,
+        CULL,
+        BLEND,
+        CATEGORY_COUNT
+    };
+
+    // per category count of calls passed on to GL and calls dropped as redundant
+    struct Counters {
+        unsigned int issued[CATEGORY_COUNT];
+        unsigned int elided[CATEGORY_COUNT];
+
+        unsigned int totalIssued() const { return sum(issued); }
+        unsigned int totalElided() const { return sum(elided); }
+
+    private:
+        static unsigned int sum(const unsigned int *counts)
+        {
+            unsigned int total = 0;
+            for (int i = 0; i < CATEGORY_COUNT; i++)
+                total += counts[i];
+            return total;
+        }
+    };
+
+    static const unsigned int TEXTURE_UNITS = 16;
+
+    GLStateCache()
+    {
+        memset(&current, 0, sizeof(current));
+        memset(&finished, 0, sizeof(finished));
+        invalidate();
+    }
+
+    void useProgram(GLuint program)
+    {
+        if (!changed(PROGRAM, state.program, program))
+            return;
+        glUseProgram(program);
+    }
+
+    void bindVertexArray(GLuint vertexArray)
+    {
+        if (!changed(VERTEX_ARRAY, state.vertexArray, vertexArray))
+            return;
+        glBindVertexArray(vertexArray);
+    }
+
+    // binds texture to target on the given unit, the active unit is only switched when the binding changes
+    void bindTexture(unsigned int unit, GLenum target, GLuint texture)
+    {
+        if (unit >= TEXTURE_UNITS || targetSlot(target) >= TARGET_SLOTS) {
+            // untracked, pass straight through
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(target, texture);
+            state.activeUnit = UNKNOWN;
+            return;
+        }
+        if (!changed(TEXTURE, state.textures[unit][targetSlot(target)], texture))
+            return;
+        if (state.activeUnit != unit) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            state.activeUnit = unit;
+        }
+        glBindTexture(target, texture);
+    }
+
+    // GL_FRAMEBUFFER only, draw and read are always bound together
+    void bindFramebuffer(GLuint framebuffer)
+    {
+        if (!changed(FRAMEBUFFER, state.framebuffer, framebuffer))
+            return;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+
+    void setDepthTest(bool enabled) { setCapability(DEPTH, GL_DEPTH_TEST, state.depthTest, enabled); }
+    void setCullFace(bool enabled) { setCapability(CULL, GL_CULL_FACE, state.cullFace, enabled); }
+    void setBlend(bool enabled) { setCapability(BLEND, GL_BLEND, state.blend, enabled); }
+
+    void depthFunc(GLenum func)
+    {
+        if (!changed(DEPTH, state.depthFunc, func))
+            return;
+        glDepthFunc(func);
+    }
+
+    void depthMask(bool write)
+    {
+        if (!changed(DEPTH, state.depthMask, write ? 1u : 0u))
+            return;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void cullFace(GLenum face)
+    {
+        if (!changed(CULL, state.cullMode, face))
+            return;
+        glCullFace(face);
+    }
+
+    void blendFunc(GLenum source, GLenum destination)
+    {
+        if (state.blendSource == source && state.blendDestination == destination) {
+            current.elided[BLEND]++;
+            return;
+        }
+        current.issued[BLEND]++;
+        state.blendSource = source;
+        state.blendDestination = destination;
+        glBlendFunc(source, destination);
+    }
+
+    // all four channels of every draw buffer together, counted with the blend state
+    void colorMask(bool write)
+    {
+        if (!changed(BLEND, state.colorMask, write ? 1u : 0u))
+            return;
+        GLboolean mask = write ? GL_TRUE : GL_FALSE;
+        glColorMask(mask, mask, mask, mask);
+    }
+
+    // deleting an object that is bound reverts the binding to 0 and the name can come back from
+    // glGen* later, so the cache must forget it in the same step
+    void deleteTexture(GLuint texture)
+    {
+        for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++)
+            for (unsigned int slot = 0; slot < TARGET_SLOTS; slot++)
+                if (state.textures[unit][slot] == texture)
+                    state.textures[unit][slot] = 0;
+        glDeleteTextures(1, &texture);
+    }
+
+    void deleteVertexArray(GLuint vertexArray)
+    {
+        if (state.vertexArray == vertexArray)
+            state.vertexArray = 0;
+        glDeleteVertexArrays(1, &vertexArray);
+    }
+
+    // forget everything, the next call of every kind goes through to GL
+    void invalidate()
+    {
+        state.program = UNKNOWN;
+        state.vertexArray = UNKNOWN;
+        state.framebuffer = UNKNOWN;
+        state.activeUnit = UNKNOWN;
+        for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++)
+            for (unsigned int slot = 0; slot < TARGET_SLOTS; slot++)
+                state.textures[unit][slot] = UNKNOWN;
+        state.depthTest = state.cullFace = state.blend = UNKNOWN;
+        state.depthFunc = state.depthMask = state.cullMode = UNKNOWN;
+        state.blendSource = state.blendDestination = state.colorMask = UNKNOWN;
+    }
+
+    // closes the frame's counters, frameCounters() returns them until the next endFrame()
+    void endFrame()
+    {
+        finished = current;
+        memset(&current, 0, sizeof(current));
+    }
+
+    const Counters &frameCounters() const { return finished; }
+
+    static const char *categoryName(Category category)
+    {
+        static const char *const names[CATEGORY_COUNT] = {
+            "program", "vertex array", "texture", "framebuffer", "depth", "cull", "blend"
+        };
+        return names[category];
+    }
+
+private:
+    // never a valid name or enum, so nothing compares equal to it
+    static const GLuint UNKNOWN = 0xffffffffu;
+    // texture targets tracked per unit: 2D and cube map
+    static const unsigned int TARGET_SLOTS = 2;
+
+    struct State {
+        GLuint program;
+        GLuint vertexArray;
+        GLuint framebuffer;
+        GLuint activeUnit;
+        GLuint textures[TEXTURE_UNITS][TARGET_SLOTS];
+        GLuint depthTest, cullFace, blend;
+        GLuint depthFunc, depthMask, cullMode;
+        GLuint blendSource, blendDestination, colorMask;
+    };
+
+    State state;
+    Counters current;
+    Counters finished;
+
+    // records value as the new state, returns whether it differs from the old one
+    bool changed(Category category, GLuint &tracked, GLuint value)
+    {
+        if (tracked == value) {
+            current.elided[category]++;
+            return false;
+        }
+        current.issued[category]++;
+        tracked = value;
+        return true;
+    }
+
+    void setCapability(Category category, GLenum capability, GLuint &tracked, bool enabled)
+    {
+        if (!changed(category, tracked, enabled ? 1u : 0u))
+            return;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    static unsigned int targetSlot(GLenum target)
+    {
+        return target == GL_TEXTURE_2D ? 0 : target == GL_TEXTURE_CUBE_MAP ? 1 : TARGET_SLOTS;
+    }
+};
+
+// the one context's state, shared by every mesh, shader and texture helper
+inline GLStateCache &glState()
+{
+    static GLStateCache cache;
+    return cache;
+}
+#endif
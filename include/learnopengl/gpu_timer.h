@@ -0,0 +1,65 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// GPU time of a stretch of the frame, with GL_TIME_ELAPSED queries (core since 3.3).
+//
+// Every frame gets a query of its own out of a small ring, and a frame's result is only read
+// LATENCY - 1 frames later, when the GPU is long done with it, so reading never stalls. Results
+// that still aren't there are skipped. milliseconds() is smoothed over the last frames so the
+// overlay stays readable.
+class GpuTimer
+{
+public:
+    GpuTimer() : frame(0), average(0.0f)
+    {
+        glGenQueries(LATENCY, queries);
+        for (unsigned int i = 0; i < LATENCY; i++)
+            issued[i] = false;
+    }
+
+    ~GpuTimer()
+    {
+        glDeleteQueries(LATENCY, queries);
+    }
+
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+    // begin and end enclose the draws to measure, no other GL_TIME_ELAPSED query may run in between
+    void begin()
+    {
+        glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+    }
+
+    void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        issued[frame] = true;
+        frame = (frame + 1) % LATENCY;
+
+        // the oldest query, reused by the next begin()
+        if (!issued[frame])
+            return;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[frame], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[frame], GL_QUERY_RESULT, &nanoseconds);
+        float milliseconds = (float) (nanoseconds / 1.0e6);
+        average = average == 0.0f ? milliseconds : average * 0.9f + milliseconds * 0.1f;
+    }
+
+    float milliseconds() const { return average; }
+
+private:
+    static const unsigned int LATENCY = 4;
+
+    unsigned int queries[LATENCY];
+    bool issued[LATENCY];
+    unsigned int frame;
+    float average;
+};
+#endif
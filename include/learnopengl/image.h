@@ -0,0 +1,126 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Decoded 8-bit image as returned by stb_image. Owns its pixels and is move-only,
+// so it can be handed from a worker thread to the GL thread through a future.
+struct Image {
+    string path;
+    int width;
+    int height;
+    int components;
+    unsigned char *data;
+
+    Image() : width(0), height(0), components(0), data(nullptr) {}
+    Image(Image &&other) : path(std::move(other.path)), width(other.width), height(other.height),
+                           components(other.components), data(other.data)
+    {
+        other.data = nullptr;
+    }
+    Image &operator=(Image &&other)
+    {
+        if (this != &other) {
+            release();
+            path = std::move(other.path);
+            width = other.width;
+            height = other.height;
+            components = other.components;
+            data = other.data;
+            other.data = nullptr;
+        }
+        return *this;
+    }
+    Image(const Image &) = delete;
+    Image &operator=(const Image &) = delete;
+    ~Image() { release(); }
+
+    // GL pixel format matching the number of channels in the file
+    GLenum format() const
+    {
+        if (components == 1)
+            return GL_RED;
+        else if (components == 3)
+            return GL_RGB;
+        return GL_RGBA;
+    }
+
+    void release()
+    {
+        if (data)
+            stbi_image_free(data);
+        data = nullptr;
+    }
+};
+
+// reverses the row order in place, stb_image always decodes the top row first
+inline void flipRows(Image &image)
+{
+    size_t rowSize = (size_t) image.width * image.components;
+    vector<unsigned char> row(rowSize);
+    for (int top = 0, bottom = image.height - 1; top < bottom; top++, bottom--) {
+        unsigned char *a = image.data + top * rowSize;
+        unsigned char *b = image.data + bottom * rowSize;
+        memcpy(row.data(), a, rowSize);
+        memcpy(a, b, rowSize);
+        memcpy(b, row.data(), rowSize);
+    }
+}
+
+// Decodes an image file, safe to call from worker threads: the flip is done here rather than through
+// stbi_set_flip_vertically_on_load, whose global flag would race between concurrent decodes.
+inline Image loadImage(const string &path, bool flip = false)
+{
+    Image image;
+    image.path = path;
+    image.data = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+    if (image.data && flip)
+        flipRows(image);
+    return image;
+}
+
+// same as loadImage, for a file that has already been read into memory
+inline Image decodeImage(const vector<unsigned char> &bytes, const string &path, bool flip = false)
+{
+    Image image;
+    image.path = path;
+    if (!bytes.empty())
+        image.data = stbi_load_from_memory(bytes.data(), (int) bytes.size(), &image.width, &image.height, &image.components, 0);
+    if (image.data && flip)
+        flipRows(image);
+    return image;
+}
+
+inline bool readFileBytes(const string &path, vector<unsigned char> &bytes)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    bytes.resize(size > 0 ? size : 0);
+    bool ok = size > 0 && fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    fclose(file);
+    return ok;
+}
+
+// FNV-1a over raw bytes, identifies identical files regardless of their name
+inline uint64_t hashBytes64(const unsigned char *bytes, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+#endif
@@ -0,0 +1,259 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/model.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/texture_loader.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// Octahedral impostor of a model, for instances far enough away that even its coarsest level of
+// detail is wasted triangles.
+//
+// The model is baked once into an atlas of FRAMES x FRAMES orthographic views of its bounding sphere.
+// The view directions cover the whole sphere: frame (i, j) looks from the direction that the
+// octahedral encoding (the one from vertex_format.h) maps the frame's center to. Two textures per
+// frame, albedo with coverage in alpha and the object space normal with the depth in alpha.
+//
+// At runtime every instance is a single camera facing quad (impostor.vs). It blends the four frames
+// around the direction to the camera, lights the result like the model shader does and writes the
+// baked depth, so impostors intersect each other and the terrain like the meshes would.
+// Over the fade band mesh and impostor dither into each other: the model shader drops the fragments
+// the impostor shader keeps (see Model::impostorFade), so the two never cover the same pixel.
+class Impostor
+{
+public:
+    static const unsigned int FRAMES = 8;
+    static const unsigned int FRAME_SIZE = 128;
+
+    glm::vec2 fade;     // distance from the camera at which the impostor starts to show and where it fully replaces the mesh
+
+    Impostor(glm::vec2 fade = glm::vec2(30.0f, 40.0f))
+        : fade(fade), center(0.0f), radius(0.0f), isBaked(false), albedo(0), normalDepth(0), instanceCount(0)
+    {
+        // corners of the quad in units of the bounding sphere radius, oriented in impostor.vs
+        float corners[] = {-1.0f, -1.0f,   1.0f, -1.0f,   -1.0f, 1.0f,   1.0f, 1.0f};
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glGenBuffers(1, &instanceVBO);
+        glState().bindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+        // one model matrix per instance, same attribute locations as the meshes use, re-pointed by prepare()
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(5 + column);
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + column, 1);
+        }
+        glState().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~Impostor()
+    {
+        glState().deleteTexture(albedo);
+        glState().deleteTexture(normalDepth);
+        glState().deleteVertexArray(quadVAO);
+        glDeleteBuffers(1, &quadVBO);
+        glDeleteBuffers(1, &instanceVBO);
+    }
+
+    Impostor(const Impostor &) = delete;
+    Impostor &operator=(const Impostor &) = delete;
+
+    bool baked() const { return isBaked; }
+
+    // bakes the model once all of its textures streamed in (or failed to), so the atlas doesn't
+    // freeze the placeholder texel. Call every frame before the scene framebuffer is bound, returns
+    // baked(). Leaves framebuffer 0 bound.
+    bool bakeWhenReady(Model &model, Shader &bakeShader)
+    {
+        if (isBaked)
+            return true;
+        bool ready = textureLoader().pendingCount() == 0;
+        if (!ready) {
+            ready = true;
+            for (const Mesh &mesh : model.meshes)
+                for (const Texture &texture : mesh.textures)
+                    ready = ready && textureLoader().isReady(texture.id);
+        }
+        if (ready)
+            bake(model, bakeShader);
+        return isBaked;
+    }
+
+    // renders the atlas right away with bakeShader (impostor_bake.vs/fs)
+    void bake(Model &model, Shader &bakeShader)
+    {
+        Aabb bounds = model.Bounds();
+        center = bounds.center();
+        radius = glm::length(bounds.extent());
+        if (radius <= 0.0f) {
+            cout << "ERROR::IMPOSTOR:: Model has no geometry to bake" << endl;
+            return;
+        }
+
+        unsigned int size = FRAMES * FRAME_SIZE;
+        albedo = createAtlasTexture(size);
+        normalDepth = createAtlasTexture(size);
+        unsigned int framebuffer, depthBuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glState().bindFramebuffer(framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalDepth, 0);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::IMPOSTOR:: Framebuffer not complete!" << endl;
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        // coverage and everything else start out at 0 where the model isn't
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glState().setCullFace(false);
+        glState().depthFunc(GL_LESS);
+        glState().depthMask(true);
+        glState().colorMask(true);
+
+        static constexpr UniformId BAKE_VIEW_PROJECTION("bakeViewProjection");
+        static constexpr UniformId BAKE_EYE("bakeEye");
+        static constexpr UniformId BAKE_DIRECTION("bakeDirection");
+        static constexpr UniformId BAKE_RADIUS("bakeRadius");
+        bakeShader.use();
+        bakeShader.setFloat(BAKE_RADIUS, radius);
+        for (unsigned int y = 0; y < FRAMES; y++)
+            for (unsigned int x = 0; x < FRAMES; x++)
+            {
+                // the sphere seen from frameDirection, 2 radii out, fills the frame exactly
+                glm::vec3 direction = frameDirection(x, y);
+                glm::vec3 eye = center + direction * (2.0f * radius);
+                glm::vec3 up = std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                glm::mat4 view = glm::lookAt(eye, center, up);
+                glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+                bakeShader.setMat4(BAKE_VIEW_PROJECTION, projection * view);
+                bakeShader.setVec3(BAKE_EYE, eye);
+                bakeShader.setVec3(BAKE_DIRECTION, -direction);
+                glViewport(x * FRAME_SIZE, y * FRAME_SIZE, FRAME_SIZE, FRAME_SIZE);
+                model.Draw(bakeShader);
+            }
+
+        glState().bindFramebuffer(0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glDeleteFramebuffers(1, &framebuffer);
+        for (unsigned int texture : {albedo, normalDepth}) {
+            glState().bindTexture(0, GL_TEXTURE_2D, texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        isBaked = true;
+    }
+
+    // writes the model matrices of this frame's impostor instances into the queue's stream buffer
+    void prepare(RenderQueue &queue, const vector<glm::mat4> &transforms)
+    {
+        instanceCount = (unsigned int) transforms.size();
+        if (transforms.empty())
+            return;
+        unsigned int buffer = queue.stream().buffer();
+        int first = queue.streamInstances(transforms);
+        if (first < 0) {
+            // the stream is full, this impostor's own buffer it is
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, transforms.size() * sizeof(glm::mat4), transforms.data(), GL_STREAM_DRAW);
+            buffer = instanceVBO;
+            first = 0;
+        }
+        glState().bindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        size_t start = (size_t) first * sizeof(glm::mat4);
+        for (unsigned int column = 0; column < 4; column++)
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(start + column * sizeof(glm::vec4)));
+        glState().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // draws the prepared instances with the impostor shader bound, from a PASS_ALPHA_TESTED callback
+    void draw(Shader &shader)
+    {
+        if (!isBaked || instanceCount == 0)
+            return;
+        static constexpr UniformId BOUNDS_CENTER("boundsCenter");
+        static constexpr UniformId BOUNDS_RADIUS("boundsRadius");
+        static constexpr UniformId FRAME_COUNT("frames");
+        static constexpr UniformId IMPOSTOR_FADE("impostorFade");
+        static constexpr UniformId ALBEDO("impostorAlbedo");
+        static constexpr UniformId NORMAL_DEPTH("impostorNormalDepth");
+        shader.setVec3(BOUNDS_CENTER, center);
+        shader.setFloat(BOUNDS_RADIUS, radius);
+        shader.setFloat(FRAME_COUNT, (float) FRAMES);
+        shader.setVec2(IMPOSTOR_FADE, fade);
+        shader.setInt(ALBEDO, 0);
+        shader.setInt(NORMAL_DEPTH, 1);
+        glState().bindTexture(0, GL_TEXTURE_2D, albedo);
+        glState().bindTexture(1, GL_TEXTURE_2D, normalDepth);
+        glState().bindVertexArray(quadVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instanceCount);
+    }
+
+    unsigned int size() const { return instanceCount; }
+
+private:
+    glm::vec3 center;   // object space bounding sphere
+    float radius;
+    bool isBaked;
+    unsigned int albedo, normalDepth;
+    unsigned int quadVAO, quadVBO, instanceVBO;
+    unsigned int instanceCount;
+
+    // the direction from the model towards the camera for frame (x, y), inverse of the lookup in impostor.vs
+    static glm::vec3 frameDirection(unsigned int x, unsigned int y)
+    {
+        glm::vec2 e((x + 0.5f) / FRAMES * 2.0f - 1.0f, (y + 0.5f) / FRAMES * 2.0f - 1.0f);
+        glm::vec3 v(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+        if (v.z < 0.0f) {
+            float x = (1.0f - std::fabs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f);
+            float y = (1.0f - std::fabs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+            v.x = x;
+            v.y = y;
+        }
+        return glm::normalize(v);
+    }
+
+    static unsigned int createAtlasTexture(unsigned int size)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState().bindTexture(0, GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        // mipmaps keep distant impostors from shimmering, down to 8 texels a frame so a frame doesn't
+        // average with its neighbours
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+};
+#endif
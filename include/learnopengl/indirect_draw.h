@@ -0,0 +1,64 @@
+#ifndef INDIRECT_DRAW_H
+#define INDIRECT_DRAW_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// The glad build in libs/ only covers GL 3.3 core. The multi-draw-indirect backend needs a few
+// GL 4.x enums and one entry point on top, loaded here by hand from the same loader glad uses.
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+typedef void (APIENTRYP PFNMULTIDRAWELEMENTSINDIRECT)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+// one draw in the GL_DRAW_INDIRECT_BUFFER, layout fixed by GL
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t  baseVertex;
+    uint32_t baseInstance;
+};
+
+class IndirectDraw
+{
+public:
+    IndirectDraw() : multiDrawElementsIndirect(nullptr)
+    {
+    }
+
+    // loads the entry points if the current context is 4.6 or newer, the shaders of this backend
+    // index their per-draw data with gl_DrawID, which is core GLSL from 4.60 on. Call after glad.
+    bool load(GLADloadproc loader)
+    {
+        if (GLVersion.major * 10 + GLVersion.minor < 46)
+            return false;
+        multiDrawElementsIndirect = (PFNMULTIDRAWELEMENTSINDIRECT) loader("glMultiDrawElementsIndirect");
+        return available();
+    }
+
+    bool available() const { return multiDrawElementsIndirect != nullptr; }
+
+    // draws commandCount tightly packed commands starting at byte offset of the bound GL_DRAW_INDIRECT_BUFFER
+    void multiDrawElements(GLenum indexType, size_t offset, unsigned int commandCount) const
+    {
+        multiDrawElementsIndirect(GL_TRIANGLES, indexType, (const void*) offset, (GLsizei) commandCount, 0);
+    }
+
+private:
+    PFNMULTIDRAWELEMENTSINDIRECT multiDrawElementsIndirect;
+};
+
+// the one context's indirect draw entry points, unavailable until load() succeeded
+inline IndirectDraw &indirectDraw()
+{
+    static IndirectDraw instance;
+    return instance;
+}
+#endif
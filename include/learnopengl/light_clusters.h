@@ -0,0 +1,309 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/uniform_buffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// a point light of the scene, its range follows from the attenuation (see lightRadius)
+struct PointLight {
+    glm::vec3 position;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// the light counts as out of reach where its strongest term has dropped to this. The shaders fade the
+// attenuation out towards the radius, so the cut doesn't show.
+const float LIGHT_CUTOFF = 1.0f / 32.0f;
+
+// distance at which constant + linear d + quadratic d^2 reaches intensity / LIGHT_CUTOFF,
+// 0 for a light that is below the cutoff right at its position
+inline float lightRadius(const PointLight &light)
+{
+    float intensity = 0.0f;
+    for (int i = 0; i < 3; i++)
+        intensity = std::max(intensity, std::max(light.ambient[i], std::max(light.diffuse[i], light.specular[i])));
+    float c = light.constant - intensity / LIGHT_CUTOFF;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic > 0.0f)
+        return (-light.linear + sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+    // no falloff at all reaches everything
+    return light.linear > 0.0f ? -c / light.linear : 1.0e30f;
+}
+
+// Clustered point lights for forward shading.
+//
+// The view frustum is cut into TILES_X x TILES_Y screen tiles and SLICES depth slices, spaced
+// exponentially so near clusters stay small. assign() puts every light into the clusters its
+// sphere of reach touches, on the CPU; upload() hands the result to the shaders through three
+// texture buffers (core since 3.1, so this works on the GL 3.3 path):
+//   lightData      RGBA32F, four texels per light: position and radius, ambient and constant,
+//                  diffuse and linear, specular and quadratic
+//   clusterLights  RG32UI, per cluster: first entry in lightIndices and the count
+//   lightIndices   R16UI, the lights of every cluster back to back
+// plus the grid layout in the Clusters uniform block. A fragment finds its cluster from
+// gl_FragCoord and its view depth and only loops over the lights listed there, so the cost per
+// pixel follows the lights that actually reach it instead of the scene's light count.
+//
+// The tile and slice ranges of a light are conservative, a cluster may list a light that just
+// misses it but never misses one that reaches it.
+class LightClusters
+{
+public:
+    static const unsigned int TILES_X = 16;
+    static const unsigned int TILES_Y = 8;
+    static const unsigned int SLICES = 24;
+    static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    static const unsigned int MAX_LIGHTS = 65535;   // lightIndices is 16 bit, GL_MAX_TEXTURE_BUFFER_SIZE may allow fewer
+
+    // texture units of the three buffers, bound once and left there: the top three of the 16
+    // every stage has, above anything a material or pass uses
+    static const unsigned int LIGHT_DATA_UNIT = 13;
+    static const unsigned int CLUSTER_LIGHTS_UNIT = 14;
+    static const unsigned int LIGHT_INDICES_UNIT = 15;
+
+    struct Stats {
+        unsigned int lights;        // lights given to assign()
+        unsigned int visible;       // lights that reach into the frustum
+        unsigned int indices;       // entries of all clusters together
+    };
+
+    // width and height of the framebuffer the lit passes draw into
+    LightClusters(unsigned int width, unsigned int height)
+        : clusterBuffer(CLUSTERS_BINDING), width(width), height(height), lightsUploaded(false), lightsClampReported(false), indicesClampReported(false)
+    {
+        // texels per texture buffer, only 65536 are guaranteed on GL 3.3
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        maxBufferTexels = (uint32_t) std::max(maxTexels, 65536);
+        stats = Stats{0, 0, 0};
+        memset(grid, 0, sizeof(grid));
+        createBuffer(LIGHT_DATA_UNIT, GL_RGBA32F, lightDataBuffer, lightDataTexture);
+        createBuffer(CLUSTER_LIGHTS_UNIT, GL_RG32UI, clusterLightsBuffer, clusterLightsTexture);
+        createBuffer(LIGHT_INDICES_UNIT, GL_R16UI, lightIndicesBuffer, lightIndicesTexture);
+    }
+
+    ~LightClusters()
+    {
+        glDeleteTextures(1, &lightDataTexture);
+        glDeleteTextures(1, &clusterLightsTexture);
+        glDeleteTextures(1, &lightIndicesTexture);
+        glDeleteBuffers(1, &lightDataBuffer);
+        glDeleteBuffers(1, &clusterLightsBuffer);
+        glDeleteBuffers(1, &lightIndicesBuffer);
+    }
+
+    LightClusters(const LightClusters &) = delete;
+    LightClusters &operator=(const LightClusters &) = delete;
+
+    // points the sampler uniforms of a lit shader at the buffers' units
+    static void bindSamplers(Shader &shader)
+    {
+        shader.use();
+        shader.setInt("lightData", LIGHT_DATA_UNIT);
+        shader.setInt("clusterLights", CLUSTER_LIGHTS_UNIT);
+        shader.setInt("lightIndices", LIGHT_INDICES_UNIT);
+    }
+
+    // sorts the lights into the clusters of the given camera, CPU only
+    void assign(const vector<PointLight> &lights, const glm::mat4 &projection, const glm::mat4 &view, float nearPlane, float farPlane)
+    {
+        // four lightData texels per light
+        size_t lightCount = std::min(lights.size(), (size_t) std::min(MAX_LIGHTS, maxBufferTexels / 4));
+        if (lightCount < lights.size() && !lightsClampReported) {
+            cout << "ERROR::LIGHT_CLUSTERS:: " << lights.size() << " lights, only the first " << lightCount << " fit the buffers" << endl;
+            lightsClampReported = true;
+        }
+        sliceScale = SLICES / log(farPlane / nearPlane);
+        sliceBias = -log(nearPlane) * sliceScale;
+
+        lightTexels.resize(lightCount * 4);
+        ranges.clear();
+        for (size_t i = 0; i < lightCount; i++)
+        {
+            const PointLight &light = lights[i];
+            float radius = lightRadius(light);
+            lightTexels[i * 4 + 0] = glm::vec4(light.position, radius);
+            lightTexels[i * 4 + 1] = glm::vec4(light.ambient, light.constant);
+            lightTexels[i * 4 + 2] = glm::vec4(light.diffuse, light.linear);
+            lightTexels[i * 4 + 3] = glm::vec4(light.specular, light.quadratic);
+
+            // too dim to reach the cutoff anywhere, and the shader's fade would divide by the zero radius
+            if (radius <= 0.0f)
+                continue;
+            ClusterRange range;
+            range.light = (uint16_t) i;
+            if (clusterRange(glm::vec3(view * glm::vec4(light.position, 1.0f)), radius, projection, nearPlane, farPlane, range))
+                ranges.push_back(range);
+        }
+
+        // count per cluster, turn the counts into offsets, then fill in the lights
+        for (unsigned int i = 0; i < CLUSTER_COUNT; i++)
+            grid[i * 2 + 1] = 0;
+        for (const ClusterRange &range : ranges)
+            forEachCluster(range, [this](unsigned int cluster) { grid[cluster * 2 + 1]++; });
+        // lightIndices can't outgrow a texture buffer either, the clusters past the limit lose lights
+        uint32_t offset = 0;
+        bool indicesClamped = false;
+        for (unsigned int i = 0; i < CLUSTER_COUNT; i++) {
+            if (grid[i * 2 + 1] > maxBufferTexels - offset) {
+                grid[i * 2 + 1] = maxBufferTexels - offset;
+                indicesClamped = true;
+            }
+            grid[i * 2] = offset;
+            offset += grid[i * 2 + 1];
+            cursor[i] = grid[i * 2];
+        }
+        if (indicesClamped && !indicesClampReported) {
+            cout << "ERROR::LIGHT_CLUSTERS:: more than " << maxBufferTexels << " light indices, clusters dropped lights" << endl;
+            indicesClampReported = true;
+        }
+        lightIndices.resize(offset);
+        for (const ClusterRange &range : ranges)
+            forEachCluster(range, [this, &range](unsigned int cluster) {
+                if (cursor[cluster] < grid[cluster * 2] + grid[cluster * 2 + 1])
+                    lightIndices[cursor[cluster]++] = range.light;
+            });
+
+        stats.lights = (unsigned int) lightCount;
+        stats.visible = (unsigned int) ranges.size();
+        stats.indices = offset;
+    }
+
+    // uploads the last assign(), the light data only when a light changed
+    void upload()
+    {
+        size_t lightBytes = lightTexels.size() * sizeof(glm::vec4);
+        if (!lightsUploaded || lightTexels.size() != uploadedTexels.size()
+            || memcmp(lightTexels.data(), uploadedTexels.data(), lightBytes) != 0) {
+            uploadedTexels = lightTexels;
+            lightsUploaded = true;
+            fill(lightDataBuffer, lightTexels.data(), lightBytes, GL_STATIC_DRAW);
+        }
+        fill(clusterLightsBuffer, grid, sizeof(grid), GL_STREAM_DRAW);
+        fill(lightIndicesBuffer, lightIndices.data(), lightIndices.size() * sizeof(uint16_t), GL_STREAM_DRAW);
+
+        ClusterData data;
+        data.grid = glm::uvec4(TILES_X, TILES_Y, SLICES, stats.lights);
+        data.params = glm::vec4((float) width / TILES_X, (float) height / TILES_Y, sliceScale, sliceBias);
+        clusterBuffer.update(data);
+    }
+
+    const Stats &lastStats() const { return stats; }
+
+private:
+    // the clusters one light reaches, inclusive
+    struct ClusterRange {
+        uint16_t light;
+        uint16_t x0, x1, y0, y1, z0, z1;
+    };
+
+    UniformBuffer<ClusterData> clusterBuffer;
+    unsigned int width, height;
+    unsigned int lightDataBuffer, clusterLightsBuffer, lightIndicesBuffer;
+    unsigned int lightDataTexture, clusterLightsTexture, lightIndicesTexture;
+    float sliceScale, sliceBias;
+    vector<glm::vec4> lightTexels, uploadedTexels;
+    bool lightsUploaded;
+    uint32_t maxBufferTexels;   // GL_MAX_TEXTURE_BUFFER_SIZE
+    bool lightsClampReported, indicesClampReported;    // the clamping errors are printed once, not every frame
+    vector<ClusterRange> ranges;
+    uint32_t grid[CLUSTER_COUNT * 2];
+    uint32_t cursor[CLUSTER_COUNT];
+    vector<uint16_t> lightIndices;
+    Stats stats;
+
+    static void createBuffer(unsigned int unit, GLenum format, unsigned int &buffer, unsigned int &texture)
+    {
+        // never empty, a texture buffer over a zero sized store is undefined on some drivers
+        uint32_t zero[4] = {0, 0, 0, 0};
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(zero), zero, GL_STATIC_DRAW);
+        glGenTextures(1, &texture);
+        glState().bindTexture(unit, GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // respecifies the whole store, the driver hands out fresh memory instead of waiting for draws
+    // still reading the old contents. The texture keeps pointing at the buffer.
+    static void fill(unsigned int buffer, const void *data, size_t bytes, GLenum usage)
+    {
+        if (bytes == 0)
+            return;
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, bytes, data, usage);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    unsigned int slice(float depth) const
+    {
+        float s = floor(log(depth) * sliceScale + sliceBias);
+        return (unsigned int) std::min(std::max(s, 0.0f), (float) (SLICES - 1));
+    }
+
+    // tile of a normalized device coordinate, clamped to the grid
+    static unsigned int tile(float ndc, unsigned int tiles)
+    {
+        float t = floor((ndc * 0.5f + 0.5f) * tiles);
+        return (unsigned int) std::min(std::max(t, 0.0f), (float) (tiles - 1));
+    }
+
+    // the screen extent of the sphere's box between two view depths, along one axis with projection scale p
+    static void ndcExtent(float center, float radius, float p, float nearDepth, float farDepth, float &low, float &high)
+    {
+        float minimum = center - radius, maximum = center + radius;
+        low = p * std::min(minimum / nearDepth, minimum / farDepth);
+        high = p * std::max(maximum / nearDepth, maximum / farDepth);
+    }
+
+    // clusters touched by a sphere around view space center, false if it misses the frustum
+    bool clusterRange(glm::vec3 center, float radius, const glm::mat4 &projection, float nearPlane, float farPlane, ClusterRange &range) const
+    {
+        // view space looks down -z
+        float nearDepth = std::max(-center.z - radius, nearPlane);
+        float farDepth = std::min(-center.z + radius, farPlane);
+        if (nearDepth > farDepth)
+            return false;
+        float left, right, bottom, top;
+        ndcExtent(center.x, radius, projection[0][0], nearDepth, farDepth, left, right);
+        ndcExtent(center.y, radius, projection[1][1], nearDepth, farDepth, bottom, top);
+        if (right < -1.0f || left > 1.0f || top < -1.0f || bottom > 1.0f)
+            return false;
+        range.x0 = (uint16_t) tile(left, TILES_X);
+        range.x1 = (uint16_t) tile(right, TILES_X);
+        range.y0 = (uint16_t) tile(bottom, TILES_Y);
+        range.y1 = (uint16_t) tile(top, TILES_Y);
+        range.z0 = (uint16_t) slice(nearDepth);
+        range.z1 = (uint16_t) slice(farDepth);
+        return true;
+    }
+
+    template<typename F>
+    static void forEachCluster(const ClusterRange &range, F visit)
+    {
+        for (unsigned int z = range.z0; z <= range.z1; z++)
+            for (unsigned int y = range.y0; y <= range.y1; y++)
+                for (unsigned int x = range.x0; x <= range.x1; x++)
+                    visit((z * TILES_Y + y) * TILES_X + x);
+    }
+};
+#endif
@@ -0,0 +1,82 @@
+#ifndef LOD_SELECTOR_H
+#define LOD_SELECTOR_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// height of a bounding sphere on screen as a fraction of the screen height, for a perspective
+// projection with the given vertical field of view (in radians). 1 or more once the camera is inside.
+inline float screenSize(glm::vec3 center, float radius, glm::vec3 viewPosition, float fovY)
+{
+    float distance = glm::length(center - viewPosition);
+    if (distance <= radius)
+        return 1.0f;
+    return radius / (distance * std::tan(0.5f * fovY));
+}
+
+inline float screenSize(const Aabb &bounds, glm::vec3 viewPosition, float fovY)
+{
+    return screenSize(bounds.center(), glm::length(bounds.extent()), viewPosition, fovY);
+}
+
+// Picks a level of detail per instance from its size on screen. Level 0 is used down to
+// fullDetailSize, every further level covers half the size of the one before, matching the
+// simplifier's halving of the triangle count.
+//
+// Each instance remembers its level and only leaves it once the size is past the threshold by the
+// hysteresis margin, so an instance sitting at a threshold doesn't flicker between two levels.
+// Instances are the caller's stable ids, e.g. scene object ids.
+class LodSelector
+{
+public:
+    LodSelector(float fullDetailSize = 0.4f, float hysteresis = 0.15f)
+        : fullDetailSize(fullDetailSize), hysteresis(hysteresis)
+    {
+    }
+
+    // makes room for instances 0..count-1 up front, after which select() can run on several threads
+    // at once as long as each instance is only selected by one of them
+    void reserve(unsigned int count)
+    {
+        if (count > current.size())
+            current.resize(count, 0);
+    }
+
+    unsigned int select(unsigned int instance, float size, unsigned int levels = MAX_LEVELS)
+    {
+        if (instance >= current.size())
+            current.resize(instance + 1, 0);
+        // the current level is kept anywhere between the level of a slightly bigger and that of a
+        // slightly smaller instance
+        unsigned int finest = levelFor(size * (1.0f + hysteresis), levels);
+        unsigned int coarsest = levelFor(size * (1.0f - hysteresis), levels);
+        uint8_t &level = current[instance];
+        if (level < finest)
+            level = (uint8_t) finest;
+        else if (level > coarsest)
+            level = (uint8_t) coarsest;
+        return level;
+    }
+
+    static const unsigned int MAX_LEVELS = 8;
+
+private:
+    float fullDetailSize;
+    float hysteresis;
+    vector<uint8_t> current;
+
+    unsigned int levelFor(float size, unsigned int levels) const
+    {
+        unsigned int level = 0;
+        for (float threshold = fullDetailSize; size < threshold && level + 1 < levels; threshold *= 0.5f)
+            level++;
+        return level;
+    }
+};
+#endif
@@ -6,29 +6,54 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/bounds.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/indirect_draw.h>
+#include <learnopengl/mesh_arena.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <vector>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-};
+// meshes with fewer than 65536 vertices are drawn with 16-bit indices, halving the index buffer
+inline GLenum indexTypeFor(size_t vertexCount)
+{
+    return vertexCount < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t indexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
 
+// returns indices in the given width, narrowing into storage when it is GL_UNSIGNED_SHORT
+inline const void *indicesAs(GLenum indexType, const vector<unsigned int> &indices, vector<unsigned short> &storage)
+{
+    if (indexType != GL_UNSIGNED_SHORT)
+        return indices.data();
+    storage.assign(indices.begin(), indices.end());
+    return storage.data();
+}
 
+// levels of detail per mesh, the base mesh included
+const unsigned int MAX_MESH_LODS = 4;
+
+// one level of detail: a range of the mesh's index buffer, all levels share its vertex buffer.
+// plain old data, stored as-is in the mesh cache.
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;            // simplification error, grows with every level, 0 for the base mesh
+};
 
 struct Texture {
-    unsigned int id;
+    unsigned int id; // texture loader handle, resolve with textureLoader().name(id) before binding
     string type;
     string path;
 };
@@ -36,34 +61,70 @@ struct Texture {
 class Mesh {
 public:
     // mesh Data
-    vector<Vertex>       vertices;
-    vector<unsigned int> indices;
     vector<Texture>      textures;
+    unsigned int indexCount;
+    GLenum indexType;
+    VertexEncoding encoding;
+    uint32_t materialKey;   // hash of the texture handles, meshes sharing textures share the key (see render_queue.h)
+    uint32_t shaderFeatures;    // what the textures ask of the shader, see shader_variants.h
+    MeshBounds bounds;      // object space, for culling
+    MeshLod lods[MAX_MESH_LODS];    // lods[0] is the full mesh, see mesh_simplifier.h
+    unsigned int lodCount;
+    int arenaPool;          // pool of meshArena() holding the geometry, -1 for buffers of its own
+    int baseVertex;         // where the mesh starts in its buffers, 0 unless it is in the arena
+    unsigned int baseIndex;
 
     unsigned int VAO;
     std::string glslIdentifierPrefix;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices, vector<Texture> textures)
+    {
+        this->textures = textures;
+        this->indexCount = indices.size();
+        this->indexType = indexTypeFor(vertices.size());
+        this->bounds = computeMeshBounds(vertices);
+        setLods(nullptr, 0);
+
+        vector<unsigned short> shortIndices;
+        setupMesh(vertices.data(), vertices.size(), indicesAs(indexType, indices, shortIndices));
+        SetTextureNamePrefix("");
+        materialKey = hashTextures();
+        shaderFeatures = textureFeatures();
+    }
+
+    // constructor from raw arrays in any vertex format, lets the mesh cache upload straight from its memory mapping.
+    // the vertex/index data is only read during construction and is not kept on the CPU.
+    // indices holds every level of detail back to back as described by lods, or just the base mesh.
+    Mesh(const void *vertices, size_t vertexCount, const VertexEncoding &encoding, const MeshBounds &bounds,
+         const void *indices, GLenum indexType, size_t indexCount, vector<Texture> textures,
+         const MeshLod *lods = nullptr, unsigned int lodCount = 0)
     {
-        this->vertices = vertices;
-        this->indices = indices;
         this->textures = textures;
+        this->indexCount = indexCount;
+        this->indexType = indexType;
+        this->encoding = encoding;
+        this->bounds = bounds;
+        setLods(lods, lodCount);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(vertices, vertexCount, indices);
+        SetTextureNamePrefix("");
+        materialKey = hashTextures();
+        shaderFeatures = textureFeatures();
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // sets the prefix of the sampler uniform names (e.g. "material."), the names are built and hashed here
+    // once instead of on every draw
+    void SetTextureNamePrefix(const std::string &prefix)
     {
-        // bind appropriate textures
+        glslIdentifierPrefix = prefix;
+        samplerNames.clear();
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,65 +136,167 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerNames.push_back(UniformId(glslIdentifierPrefix + name + number));
         }
+    }
 
+    // render the mesh
+    void Draw(Shader &shader)
+    {
+        BindMaterial(shader);
 
+        // draw mesh, the VAO and textures stay bound so the next draw of the same mesh skips rebinding them
+        glState().bindVertexArray(VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, lods[0].indexCount, indexType, indexOffset(lods[0]), baseVertex);
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // render instanceCount copies of the mesh in one call, the per-instance model matrices come from
+    // the buffer given to SetInstanceBuffer. lod is clamped to the levels the mesh has.
+    void DrawInstanced(Shader &shader, unsigned int instanceCount, unsigned int lod = 0)
+    {
+        BindMaterial(shader);
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        const MeshLod &level = lods[std::min(lod, lodCount - 1)];
+        glState().bindVertexArray(VAO);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, indexType, indexOffset(level), instanceCount, baseVertex);
+    }
+
+    // the command DrawInstanced would draw, for glMultiDrawElementsIndirect over the arena pool. The
+    // matrices come from the pool's instance buffer at firstInstance, see MeshArena::setInstanceBuffer.
+    DrawElementsIndirectCommand IndirectCommand(unsigned int instanceCount, unsigned int firstInstance, unsigned int lod = 0) const
+    {
+        const MeshLod &level = lods[std::min(lod, lodCount - 1)];
+        DrawElementsIndirectCommand command;
+        command.count = level.indexCount;
+        command.instanceCount = instanceCount;
+        command.firstIndex = baseIndex + level.firstIndex;
+        command.baseVertex = baseVertex;
+        command.baseInstance = firstInstance;
+        return command;
+    }
+
+    // sources attribute locations 5-8 (one mat4 per instance) from buffer, starting at matrix firstInstance
+    // and advancing once per instance. Only touches the VAO when the buffer or the start changed.
+    void SetInstanceBuffer(unsigned int buffer, unsigned int firstInstance = 0)
+    {
+        // meshes in the arena share the VAO of their pool, and with it this state
+        if (arenaPool >= 0) {
+            meshArena().setInstanceBuffer(arenaPool, buffer, firstInstance);
+            return;
+        }
+        if (buffer == instanceBuffer && firstInstance == instanceFirst)
+            return;
+        instanceBuffer = buffer;
+        instanceFirst = firstInstance;
+        glState().bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        size_t start = (size_t) firstInstance * sizeof(glm::mat4);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(5 + column);
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(start + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + column, 1);
+        }
+        glState().bindVertexArray(0);
+    }
+
+    // binds the textures and sets the per-mesh uniforms shared by all draw paths
+    void BindMaterial(Shader &shader)
+    {
+        // bind appropriate textures
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            // set the sampler to the correct texture unit
+            shader.setInt(samplerNames[i], i);
+            // and bind the texture, the state cache only switches the unit if the binding changes
+            glState().bindTexture(i, GL_TEXTURE_2D, textureLoader().name(textures[i].id));
+        }
+
+        // compact vertices are decoded in the vertex shader
+        static constexpr UniformId COMPACT_VERTICES("compactVertices");
+        static constexpr UniformId POSITION_SCALE("positionScale");
+        static constexpr UniformId POSITION_OFFSET("positionOffset");
+        shader.setBool(COMPACT_VERTICES, encoding.format == VERTEX_COMPACT);
+        shader.setVec3(POSITION_SCALE, encoding.positionScale[0], encoding.positionScale[1], encoding.positionScale[2]);
+        shader.setVec3(POSITION_OFFSET, encoding.positionOffset[0], encoding.positionOffset[1], encoding.positionOffset[2]);
     }
 
 private:
     // render data
     unsigned int VBO, EBO;
+    unsigned int instanceBuffer = 0, instanceFirst = 0;   // what attributes 5-8 point at, see SetInstanceBuffer
+    vector<UniformId> samplerNames;     // sampler uniform of every texture, see SetTextureNamePrefix
+
+    // byte offset of a level's first index in the bound element buffer
+    void *indexOffset(const MeshLod &level) const
+    {
+        return (void*)((size_t) (baseIndex + level.firstIndex) * indexSize(indexType));
+    }
+
+    // without levels the whole index buffer is the only one
+    void setLods(const MeshLod *levels, unsigned int count)
+    {
+        lodCount = std::max(1u, std::min(count, MAX_MESH_LODS));
+        for (unsigned int i = 0; i < lodCount; i++)
+            lods[i] = count ? levels[i] : MeshLod{0, (uint32_t) indexCount, 0.0f};
+    }
+
+    // the shader variant the textures need: no specular term without a specular map, normal mapping with a normal map
+    uint32_t textureFeatures() const
+    {
+        bool specular = false, normal = false;
+        for (const Texture &texture : textures) {
+            specular = specular || texture.type == "texture_specular";
+            normal = normal || texture.type == "texture_normal";
+        }
+        return (specular ? 0u : (uint32_t) FEATURE_NO_SPECULAR) | (normal ? (uint32_t) FEATURE_HAS_NORMALMAP : 0u);
+    }
+
+    // FNV-1a over the texture handles in binding order
+    uint32_t hashTextures() const
+    {
+        uint32_t hash = 2166136261u;
+        for (const Texture &texture : textures)
+            for (unsigned int shift = 0; shift < 32; shift += 8)
+                hash = (hash ^ ((texture.id >> shift) & 0xff)) * 16777619u;
+        return hash;
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const void *vertices, size_t vertexCount, const void *indices)
     {
+        if (meshArena().enabled())
+        {
+            // the multi-draw-indirect backend, the geometry goes into the shared buffers
+            arenaPool = (int) meshArena().add(encoding.format, indexType, vertices, vertexCount, indices, indexCount, baseVertex, baseIndex);
+            VAO = meshArena().vertexArray(arenaPool);
+            VBO = EBO = 0;
+            return;
+        }
+        arenaPool = -1;
+        baseVertex = 0;
+        baseIndex = 0;
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        glState().bindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * vertexStride(encoding.format), vertices, GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize(indexType), indices, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        setVertexAttributes(encoding.format);
+
+        glState().bindVertexArray(0);
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,165 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+// Shared vertex and index buffers for the multi-draw-indirect backend.
+//
+// Meshes created while the arena is enabled copy their geometry in here instead of into buffers
+// of their own. Meshes of the same vertex format and index type end up in one pool, behind one VAO,
+// so a run of them can go out as a single glMultiDrawElementsIndirect: each draw only differs in
+// its firstIndex/baseVertex (and baseInstance for the instance matrices), see RenderQueue::execute.
+//
+// Pools grow by doubling and copy their contents over on the GPU; meshes only keep offsets, so
+// growing doesn't touch them. The buffers live as long as the context. Left disabled on the GL 3.3
+// path, where every mesh keeps its own buffers.
+class MeshArena
+{
+public:
+    MeshArena() : isEnabled(false)
+    {
+    }
+
+    MeshArena(const MeshArena &) = delete;
+    MeshArena &operator=(const MeshArena &) = delete;
+
+    // meshes created from now on go into the arena
+    void enable() { isEnabled = true; }
+    bool enabled() const { return isEnabled; }
+
+    // copies a mesh's geometry into the pool for its format and index type, returns the pool.
+    // indices stay relative to the mesh's own vertices, draws add baseVertex.
+    unsigned int add(uint32_t format, GLenum indexType, const void *vertices, size_t vertexCount,
+                     const void *indices, size_t indexCount, int &baseVertex, unsigned int &firstIndex)
+    {
+        unsigned int index = poolFor(format, indexType);
+        Pool &pool = pools[index];
+        size_t stride = vertexStride(format);
+        size_t indexBytes = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        reserve(pool, pool.vertexCount + vertexCount, pool.indexCount + indexCount);
+
+        glBindBuffer(GL_ARRAY_BUFFER, pool.VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, pool.vertexCount * stride, vertexCount * stride, vertices);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glState().bindVertexArray(pool.VAO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, pool.indexCount * indexBytes, indexCount * indexBytes, indices);
+        glState().bindVertexArray(0);
+
+        baseVertex = (int) pool.vertexCount;
+        firstIndex = (unsigned int) pool.indexCount;
+        pool.vertexCount += vertexCount;
+        pool.indexCount += indexCount;
+        return index;
+    }
+
+    GLuint vertexArray(unsigned int pool) const { return pools[pool].VAO; }
+    GLenum indexType(unsigned int pool) const { return pools[pool].indexType; }
+
+    // sources attribute locations 5-8 of the pool's VAO from buffer, starting at matrix firstInstance.
+    // The indirect path always uses 0 and picks the matrices through each command's baseInstance.
+    void setInstanceBuffer(unsigned int pool, unsigned int buffer, unsigned int firstInstance)
+    {
+        Pool &target = pools[pool];
+        if (buffer == target.instanceBuffer && firstInstance == target.instanceFirst)
+            return;
+        target.instanceBuffer = buffer;
+        target.instanceFirst = firstInstance;
+        glState().bindVertexArray(target.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        size_t start = (size_t) firstInstance * sizeof(glm::mat4);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(5 + column);
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(start + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + column, 1);
+        }
+        glState().bindVertexArray(0);
+    }
+
+    unsigned int poolCount() const { return (unsigned int) pools.size(); }
+
+private:
+    struct Pool {
+        uint32_t format;
+        GLenum indexType;
+        unsigned int VAO, VBO, EBO;
+        size_t vertexCount, vertexCapacity;
+        size_t indexCount, indexCapacity;
+        unsigned int instanceBuffer, instanceFirst;
+    };
+
+    bool isEnabled;
+    vector<Pool> pools;
+
+    unsigned int poolFor(uint32_t format, GLenum indexType)
+    {
+        for (unsigned int i = 0; i < pools.size(); i++)
+            if (pools[i].format == format && pools[i].indexType == indexType)
+                return i;
+        Pool pool;
+        pool.format = format;
+        pool.indexType = indexType;
+        pool.VBO = pool.EBO = 0;
+        pool.vertexCount = pool.vertexCapacity = pool.indexCount = pool.indexCapacity = 0;
+        pool.instanceBuffer = pool.instanceFirst = 0;
+        glGenVertexArrays(1, &pool.VAO);
+        pools.push_back(pool);
+        return (unsigned int) pools.size() - 1;
+    }
+
+    // grows the pool's buffers to hold at least the given counts, keeping their contents
+    void reserve(Pool &pool, size_t vertexCount, size_t indexCount)
+    {
+        if (vertexCount <= pool.vertexCapacity && indexCount <= pool.indexCapacity)
+            return;
+        size_t stride = vertexStride(pool.format);
+        size_t indexBytes = pool.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        size_t vertexCapacity = std::max(vertexCount, pool.vertexCapacity * 2);
+        size_t indexCapacity = std::max(indexCount, pool.indexCapacity * 2);
+        pool.VBO = grow(pool.VBO, pool.vertexCount * stride, vertexCapacity * stride);
+        pool.EBO = grow(pool.EBO, pool.indexCount * indexBytes, indexCapacity * indexBytes);
+        pool.vertexCapacity = vertexCapacity;
+        pool.indexCapacity = indexCapacity;
+
+        // the VAO still points at the old buffers
+        glState().bindVertexArray(pool.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, pool.VBO);
+        setVertexAttributes(pool.format);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.EBO);
+        glState().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // a new buffer of the given size with the first usedBytes of the old one, which is deleted
+    static unsigned int grow(unsigned int buffer, size_t usedBytes, size_t bytes)
+    {
+        unsigned int grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+        if (buffer) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+            glDeleteBuffers(1, &buffer);
+        }
+        return grown;
+    }
+};
+
+// the one context's arena, disabled unless the multi-draw-indirect backend is active
+inline MeshArena &meshArena()
+{
+    static MeshArena arena;
+    return arena;
+}
+#endif
@@ -0,0 +1,355 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/filesystem.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+using namespace std;
+
+// Bump whenever the on-disk layout or the post-processing that produces the cached data changes.
+const uint32_t MESH_CACHE_VERSION = 5;
+
+// optional import stages, part of the cache key next to the Assimp flags.
+enum MeshCacheOptions {
+    MESH_CACHE_OPTIMIZED = 1 << 0,      // meshes went through optimizeMesh, see mesh_optimizer.h
+    MESH_CACHE_COMPACT_VERTICES = 1 << 1, // vertices are stored as CompactVertex, see vertex_format.h
+    MESH_CACHE_LODS = 1 << 2            // indices carry a chain of simplified levels, see mesh_simplifier.h
+};
+
+// CPU-side result of importing a single mesh, before it is uploaded to the GPU.
+struct MeshData {
+    vector<Vertex>        vertices;
+    vector<unsigned int>  indices;
+    vector<Texture>       textures;
+    VertexEncoding        encoding;
+    MeshBounds            bounds;          // computed at import, before quantization
+    vector<CompactVertex> compactVertices; // used instead of vertices once the mesh is quantized
+    vector<MeshLod>       lods;            // index ranges of the levels of detail, empty for just the base mesh
+
+    // packs the vertices into CompactVertex and frees the float ones
+    void quantize()
+    {
+        quantizeVertices(vertices, compactVertices, encoding);
+        vector<Vertex>().swap(vertices);
+    }
+
+    size_t vertexCount() const
+    {
+        return encoding.format == VERTEX_COMPACT ? compactVertices.size() : vertices.size();
+    }
+
+    const void *vertexData() const
+    {
+        return encoding.format == VERTEX_COMPACT ? (const void *) compactVertices.data() : (const void *) vertices.data();
+    }
+};
+
+// on-disk layout: header, mesh records, texture records, then 16-byte aligned vertex/index blobs.
+// indices are stored in the width they are drawn with, 16-bit whenever the vertex count allows it.
+struct MeshCacheHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t importFlags;
+    uint32_t options;
+    uint32_t meshCount;
+    uint32_t reserved;
+    int64_t  sourceMtime;
+    uint64_t sourceSize;
+    uint64_t pathHash;
+};
+
+struct MeshCacheRecord {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    uint32_t indexType;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    VertexEncoding encoding;
+    MeshBounds bounds;
+    uint32_t lodCount;    // 0 if the indices are just the base mesh
+    MeshLod lods[MAX_MESH_LODS];
+};
+
+struct MeshCacheTexture {
+    char type[32];
+    char path[224];
+};
+
+// FNV-1a, good enough to tell source files apart in the cache directory.
+inline uint64_t hashString64(const string &s)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : s) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Read-only memory mapping of a whole file, unmapped when it goes out of scope.
+class MappedFile
+{
+public:
+    MappedFile() : data(nullptr), size(0) {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const string &path)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps its own reference to the file
+        if (mapping == MAP_FAILED)
+            return false;
+        data = static_cast<const char *>(mapping);
+        size = st.st_size;
+        return true;
+    }
+
+    void close()
+    {
+        if (data)
+            munmap(const_cast<char *>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+
+    const char *data;
+    size_t size;
+};
+
+// Versioned binary cache of post-processed mesh data, one file per source model.
+// The cache is keyed by the source path, its mtime and size, and the Assimp import flags,
+// so touching the .obj or changing the post-processing invalidates it automatically.
+class MeshCache
+{
+public:
+    MeshCache(const string &sourcePath, unsigned int importFlags, unsigned int options = 0)
+        : importFlags(importFlags), options(options)
+    {
+        key.pathHash = hashString64(sourcePath);
+        key.sourceMtime = 0;
+        key.sourceSize = 0;
+        struct stat st;
+        if (stat(sourcePath.c_str(), &st) == 0) {
+            key.sourceMtime = (int64_t) st.st_mtime;
+            key.sourceSize = (uint64_t) st.st_size;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long) key.pathHash);
+        string base = sourcePath.substr(sourcePath.find_last_of('/') + 1);
+        cachePath = cacheDirectory() + "/" + base + "." + name + ".meshcache";
+    }
+
+    // maps the cache file and validates it against the source; on success the mesh data can be
+    // read straight out of the mapping through the accessors below.
+    bool load()
+    {
+        if (!file.open(cachePath))
+            return false;
+        if (!validate()) {
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    unsigned int meshCount() const { return header()->meshCount; }
+    const MeshCacheRecord &mesh(unsigned int i) const { return records()[i]; }
+    // laid out as described by mesh(i).encoding
+    const void *vertices(unsigned int i) const
+    {
+        return file.data + mesh(i).vertexOffset;
+    }
+    // 16 or 32-bit indices depending on mesh(i).indexType
+    const void *indices(unsigned int i) const
+    {
+        return file.data + mesh(i).indexOffset;
+    }
+    const MeshCacheTexture &texture(unsigned int meshIndex, unsigned int i) const
+    {
+        return textureRecords()[mesh(meshIndex).firstTexture + i];
+    }
+
+    // writes the imported meshes to a temporary file and renames it into place, so a crash
+    // halfway through never leaves a truncated cache behind.
+    bool store(const vector<MeshData> &meshes)
+    {
+        mkdir(cacheDirectory().c_str(), 0755);
+
+        MeshCacheHeader head;
+        memset(&head, 0, sizeof(head));
+        memcpy(head.magic, "MSHC", 4);
+        head.version = MESH_CACHE_VERSION;
+        head.importFlags = importFlags;
+        head.options = options;
+        head.meshCount = (uint32_t) meshes.size();
+        head.sourceMtime = key.sourceMtime;
+        head.sourceSize = key.sourceSize;
+        head.pathHash = key.pathHash;
+
+        vector<MeshCacheRecord> meshRecords(meshes.size());
+        vector<unsigned short> shortIndices;
+        vector<MeshCacheTexture> textures;
+        uint64_t totalTextures = 0;
+        for (const MeshData &data : meshes)
+            totalTextures += data.textures.size();
+        uint64_t offset = align(sizeof(MeshCacheHeader) + meshes.size() * sizeof(MeshCacheRecord)
+                                + totalTextures * sizeof(MeshCacheTexture));
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const MeshData &data = meshes[i];
+            MeshCacheRecord &record = meshRecords[i];
+            record.vertexCount = (uint32_t) data.vertexCount();
+            record.indexCount = (uint32_t) data.indices.size();
+            record.firstTexture = (uint32_t) textures.size();
+            record.textureCount = (uint32_t) data.textures.size();
+            record.indexType = indexTypeFor(data.vertexCount());
+            record.encoding = data.encoding;
+            record.bounds = data.bounds;
+            memset(record.lods, 0, sizeof(record.lods));
+            record.lodCount = (uint32_t) std::min(data.lods.size(), (size_t) MAX_MESH_LODS);
+            for (uint32_t lod = 0; lod < record.lodCount; lod++)
+                record.lods[lod] = data.lods[lod];
+            record.vertexOffset = offset;
+            offset = align(offset + data.vertexCount() * vertexStride(data.encoding.format));
+            record.indexOffset = offset;
+            offset = align(offset + data.indices.size() * indexSize(record.indexType));
+            for (const Texture &texture : data.textures) {
+                MeshCacheTexture entry;
+                memset(&entry, 0, sizeof(entry));
+                if (texture.type.size() >= sizeof(entry.type) || texture.path.size() >= sizeof(entry.path)) {
+                    cout << "ERROR::MESH_CACHE:: texture path too long to cache: " << texture.path << endl;
+                    return false;
+                }
+                memcpy(entry.type, texture.type.c_str(), texture.type.size());
+                memcpy(entry.path, texture.path.c_str(), texture.path.size());
+                textures.push_back(entry);
+            }
+        }
+
+        string tmpPath = cachePath + ".tmp";
+        FILE *out = fopen(tmpPath.c_str(), "wb");
+        if (!out) {
+            cout << "ERROR::MESH_CACHE:: could not write " << tmpPath << endl;
+            return false;
+        }
+        bool ok = fwrite(&head, sizeof(head), 1, out) == 1;
+        if (!meshRecords.empty())
+            ok = ok && fwrite(meshRecords.data(), sizeof(MeshCacheRecord), meshRecords.size(), out) == meshRecords.size();
+        if (!textures.empty())
+            ok = ok && fwrite(textures.data(), sizeof(MeshCacheTexture), textures.size(), out) == textures.size();
+        for (size_t i = 0; ok && i < meshes.size(); i++) {
+            const MeshCacheRecord &record = meshRecords[i];
+            const void *indexData = indicesAs(record.indexType, meshes[i].indices, shortIndices);
+            ok = pad(out, record.vertexOffset)
+                 && fwrite(meshes[i].vertexData(), vertexStride(record.encoding.format), record.vertexCount, out) == record.vertexCount
+                 && pad(out, record.indexOffset)
+                 && fwrite(indexData, indexSize(record.indexType), record.indexCount, out) == record.indexCount;
+        }
+        ok = fclose(out) == 0 && ok;
+        if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+            cout << "ERROR::MESH_CACHE:: failed to write " << cachePath << endl;
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    static string cacheDirectory()
+    {
+        return FileSystem::getPath("cache");
+    }
+
+private:
+    unsigned int importFlags;
+    unsigned int options;
+    MeshCacheHeader key;
+    string cachePath;
+    MappedFile file;
+
+    const MeshCacheHeader *header() const
+    {
+        return reinterpret_cast<const MeshCacheHeader *>(file.data);
+    }
+    const MeshCacheRecord *records() const
+    {
+        return reinterpret_cast<const MeshCacheRecord *>(file.data + sizeof(MeshCacheHeader));
+    }
+    const MeshCacheTexture *textureRecords() const
+    {
+        return reinterpret_cast<const MeshCacheTexture *>(records() + header()->meshCount);
+    }
+
+    bool validate() const
+    {
+        if (file.size < sizeof(MeshCacheHeader))
+            return false;
+        const MeshCacheHeader *head = header();
+        if (memcmp(head->magic, "MSHC", 4) != 0 || head->version != MESH_CACHE_VERSION
+            || head->importFlags != importFlags || head->options != options || head->pathHash != key.pathHash
+            || head->sourceMtime != key.sourceMtime || head->sourceSize != key.sourceSize)
+            return false;
+        uint64_t tableEnd = sizeof(MeshCacheHeader) + (uint64_t) head->meshCount * sizeof(MeshCacheRecord);
+        if (tableEnd > file.size)
+            return false;
+        uint64_t textureCount = 0;
+        for (unsigned int i = 0; i < head->meshCount; i++)
+            textureCount += records()[i].textureCount;
+        if (tableEnd + textureCount * sizeof(MeshCacheTexture) > file.size)
+            return false;
+        for (unsigned int i = 0; i < head->meshCount; i++) {
+            const MeshCacheRecord &record = records()[i];
+            if ((record.indexType != GL_UNSIGNED_SHORT && record.indexType != GL_UNSIGNED_INT)
+                || (record.encoding.format != VERTEX_FLOAT && record.encoding.format != VERTEX_COMPACT)
+                || record.vertexOffset + (uint64_t) record.vertexCount * vertexStride(record.encoding.format) > file.size
+                || record.indexOffset + (uint64_t) record.indexCount * indexSize(record.indexType) > file.size
+                || (uint64_t) record.firstTexture + record.textureCount > textureCount
+                || record.lodCount > MAX_MESH_LODS)
+                return false;
+            for (uint32_t lod = 0; lod < record.lodCount; lod++)
+                if ((uint64_t) record.lods[lod].firstIndex + record.lods[lod].indexCount > record.indexCount)
+                    return false;
+        }
+        return true;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t) 15;
+    }
+
+    static bool pad(FILE *out, uint64_t offset)
+    {
+        long position = ftell(out);
+        while (position >= 0 && (uint64_t) position < offset) {
+            if (fputc(0, out) == EOF)
+                return false;
+            position++;
+        }
+        return position >= 0 && (uint64_t) position == offset;
+    }
+};
+#endif
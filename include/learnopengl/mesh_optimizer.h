@@ -0,0 +1,330 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Import-time optimization of a triangle mesh, run once on a mesh cache miss:
+//   1. weld      - merges vertices whose attributes are bit-identical (Assimp emits one vertex per face corner)
+//   2. cache     - reorders triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm)
+//   3. overdraw  - reorders clusters of triangles so outward-facing ones are drawn first, keeping cache order inside them
+//   4. fetch     - renumbers vertices in first-use order so vertex fetch walks the buffer front to back
+// The result is drawn with 16-bit indices whenever the mesh has fewer than 65536 vertices, see Mesh.
+
+// size of the FIFO cache simulated for the ACMR report, a conservative value for current hardware
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// before/after numbers of one or more optimized meshes
+struct MeshOptimizerStats {
+    size_t meshes;
+    size_t triangles;
+    size_t verticesBefore, verticesAfter;
+    size_t missesBefore, missesAfter;   // simulated vertex shader invocations
+    size_t bytesBefore, bytesAfter;     // vertex + index buffer size
+
+    MeshOptimizerStats() : meshes(0), triangles(0), verticesBefore(0), verticesAfter(0),
+                           missesBefore(0), missesAfter(0), bytesBefore(0), bytesAfter(0) {}
+
+    // average cache miss ratio, vertex shader invocations per triangle: 3 is the worst case, 0.5 the ideal for a large grid
+    float acmrBefore() const { return triangles ? (float) missesBefore / triangles : 0.0f; }
+    float acmrAfter() const { return triangles ? (float) missesAfter / triangles : 0.0f; }
+};
+
+// counts the vertex shader invocations a FIFO post-transform cache of the given size would need
+inline size_t simulateVertexCache(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    // timestamp trick: a vertex is in the cache if it was inserted less than cacheSize misses ago
+    vector<size_t> insertedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (unsigned int index : indices) {
+        if (insertedAt[index] == 0 || misses + 1 - insertedAt[index] > cacheSize) {
+            misses++;
+            insertedAt[index] = misses;
+        }
+    }
+    return misses;
+}
+
+// merges vertices with equal attributes, shrinks the vertex buffer and gives the cache something to hit.
+// compares the attributes as floats, not the struct's bytes, so padding can't tell two vertices apart
+inline void weldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    struct VertexHash {
+        size_t operator()(const Vertex &v) const
+        {
+            const float attributes[14] = {v.Position.x, v.Position.y, v.Position.z, v.Normal.x, v.Normal.y, v.Normal.z,
+                                          v.TexCoords.x, v.TexCoords.y, v.Tangent.x, v.Tangent.y, v.Tangent.z,
+                                          v.Bitangent.x, v.Bitangent.y, v.Bitangent.z};
+            // FNV-1a over the attribute bits, + 0.0f folds -0 into 0 so equal vertices hash alike
+            uint64_t hash = 14695981039346656037ull;
+            for (float attribute : attributes) {
+                float value = attribute + 0.0f;
+                uint32_t bits;
+                memcpy(&bits, &value, sizeof(bits));
+                for (int i = 0; i < 4; i++) {
+                    hash ^= (bits >> (i * 8)) & 0xff;
+                    hash *= 1099511628211ull;
+                }
+            }
+            return (size_t) hash;
+        }
+    };
+    struct VertexEqual {
+        bool operator()(const Vertex &a, const Vertex &b) const
+        {
+            return a.Position == b.Position && a.Normal == b.Normal && a.TexCoords == b.TexCoords
+                   && a.Tangent == b.Tangent && a.Bitangent == b.Bitangent;
+        }
+    };
+
+    unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        auto inserted = unique.insert(make_pair(vertices[i], (unsigned int) welded.size()));
+        if (inserted.second)
+            welded.push_back(vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+    for (unsigned int &index : indices)
+        index = remap[index];
+    vertices.swap(welded);
+}
+
+// reorders triangles for the post-transform vertex cache, following Tom Forsyth's
+// "Linear-Speed Vertex Cache Optimisation": greedily emits the triangle whose vertices score highest,
+// where vertices score for being recently used and for having few triangles left.
+inline void optimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount)
+{
+    const int CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles using each vertex, as offsets into one flat array
+    vector<unsigned int> valence(vertexCount, 0);
+    for (unsigned int index : indices)
+        valence[index]++;
+    vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] = firstTriangle[v] + valence[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[filled[indices[i]]++] = (unsigned int) (i / 3);
+
+    auto vertexScore = [&](int cachePosition, unsigned int remaining) {
+        if (remaining == 0)
+            return -1.0f; // nothing left to draw with this vertex
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3)
+                score = LAST_TRIANGLE_SCORE; // part of the triangle just drawn, deliberately not the best choice
+            else
+                score = pow(1.0f - (float) (cachePosition - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+        return score + VALENCE_BOOST_SCALE * pow((float) remaining, -VALENCE_BOOST_POWER);
+    };
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, valence[v]);
+    vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    vector<unsigned int> cache, nextCache;
+    size_t scanCursor = 0;
+    int best = -1;
+
+    for (size_t drawn = 0; drawn < triangleCount; drawn++) {
+        if (best < 0) {
+            // cache ran dry, restart from the best of the first few untouched triangles
+            while (emitted[scanCursor])
+                scanCursor++;
+            best = (int) scanCursor;
+            for (size_t t = scanCursor, looked = 0; t < triangleCount && looked < 64; t++) {
+                if (emitted[t])
+                    continue;
+                looked++;
+                if (triangleScore[t] > triangleScore[best])
+                    best = (int) t;
+            }
+        }
+
+        emitted[best] = true;
+        nextCache.clear();
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[best * 3 + k];
+            result.push_back(v);
+            nextCache.push_back(v);
+            // drop the triangle from the vertex's list of remaining triangles
+            unsigned int *begin = &adjacency[firstTriangle[v]];
+            unsigned int *end = begin + valence[v];
+            *std::find(begin, end, (unsigned int) best) = *(end - 1);
+            valence[v]--;
+        }
+        for (unsigned int v : cache)
+            if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+                nextCache.push_back(v);
+
+        // rescore the vertices that moved, including the ones that just fell out of the cache
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            unsigned int v = nextCache[i];
+            cachePosition[v] = i < (size_t) CACHE_SIZE ? (int) i : -1;
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : nextCache) {
+            float updated = vertexScore(cachePosition[v], valence[v]);
+            float delta = updated - score[v];
+            score[v] = updated;
+            for (unsigned int j = 0; j < valence[v]; j++) {
+                unsigned int t = adjacency[firstTriangle[v] + j];
+                triangleScore[t] += delta;
+            }
+        }
+        for (size_t i = 0; i < nextCache.size() && i < (size_t) CACHE_SIZE; i++) {
+            unsigned int v = nextCache[i];
+            for (unsigned int j = 0; j < valence[v]; j++) {
+                unsigned int t = adjacency[firstTriangle[v] + j];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = (int) t;
+                }
+            }
+        }
+        if (nextCache.size() > (size_t) CACHE_SIZE)
+            nextCache.resize(CACHE_SIZE);
+        cache.swap(nextCache);
+    }
+    indices.swap(result);
+}
+
+// reorders the cache-optimized triangles to reduce overdraw. The triangle list is cut into clusters where
+// the simulated cache starts over, so the vertex cache efficiency survives, and the clusters are sorted
+// so those facing away from the mesh center, the ones most likely to occlude the rest, are drawn first.
+inline void optimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // a triangle whose three vertices all miss the cache starts a new cluster
+    vector<size_t> clusterStart;
+    vector<size_t> insertedAt(vertices.size(), 0);
+    size_t misses = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        int triangleMisses = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned int index = indices[t * 3 + k];
+            if (insertedAt[index] == 0 || misses + 1 - insertedAt[index] > VERTEX_CACHE_SIZE) {
+                misses++;
+                insertedAt[index] = misses;
+                triangleMisses++;
+            }
+        }
+        if (t == 0 || triangleMisses == 3)
+            clusterStart.push_back(t);
+    }
+    if (clusterStart.size() < 2)
+        return;
+    clusterStart.push_back(triangleCount);
+
+    glm::vec3 meshCenter(0.0f);
+    for (const Vertex &vertex : vertices)
+        meshCenter += vertex.Position;
+    meshCenter /= (float) vertices.size();
+
+    struct Cluster {
+        size_t first, last;
+        float sortKey;
+    };
+    vector<Cluster> clusters;
+    for (size_t c = 0; c + 1 < clusterStart.size(); c++) {
+        glm::vec3 center(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &p = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 cross = glm::cross(b - a, p - a); // length is twice the area, so the sums are area weighted
+            float weight = glm::length(cross);
+            center += (a + b + p) * (weight / 3.0f);
+            normal += cross;
+            area += weight;
+        }
+        if (area > 0.0f)
+            center /= area;
+        float length = glm::length(normal);
+        Cluster cluster = { clusterStart[c], clusterStart[c + 1], 0.0f };
+        if (length > 0.0f)
+            cluster.sortKey = glm::dot(center - meshCenter, normal / length);
+        clusters.push_back(cluster);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (const Cluster &cluster : clusters)
+        result.insert(result.end(), indices.begin() + cluster.first * 3, indices.begin() + cluster.last * 3);
+    indices.swap(result);
+}
+
+// renumbers vertices in the order the index buffer first uses them, unreferenced vertices are dropped.
+inline void optimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    const unsigned int UNUSED = ~0u;
+    vector<unsigned int> remap(vertices.size(), UNUSED);
+    vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (unsigned int &index : indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = (unsigned int) reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+}
+
+// runs the whole pipeline on one imported mesh and adds its numbers to stats.
+inline void optimizeMesh(MeshData &mesh, MeshOptimizerStats &stats)
+{
+    stats.meshes++;
+    stats.triangles += mesh.indices.size() / 3;
+    stats.verticesBefore += mesh.vertices.size();
+    stats.missesBefore += simulateVertexCache(mesh.indices, mesh.vertices.size());
+    stats.bytesBefore += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+
+    weldVertices(mesh.vertices, mesh.indices);
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh.vertices);
+    optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+    stats.verticesAfter += mesh.vertices.size();
+    stats.missesAfter += simulateVertexCache(mesh.indices, mesh.vertices.size());
+    stats.bytesAfter += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * indexSize(indexTypeFor(mesh.vertices.size()));
+}
+#endif
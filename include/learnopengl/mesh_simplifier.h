@@ -0,0 +1,279 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Import-time LOD chain generation, run on a mesh cache miss after optimizeMesh.
+//
+// Each level comes from quadric error metric edge collapses (Garland/Heckbert) on the level before it,
+// collapsing a vertex onto one of its neighbours (half edge collapse). No vertex is ever created or
+// moved, so every level indexes the base mesh's vertex buffer and is appended to its index buffer.
+// Vertices on a UV seam (another vertex shares the position) or on an open border are never
+// collapsed away, only onto, which keeps texture seams and silhouette holes where they were.
+
+// levels after the base mesh, each aiming for half the triangles of the one before
+const unsigned int MESH_LOD_LEVELS = MAX_MESH_LODS - 1;
+
+// symmetric 4x4 error quadric, sum of squared distances to a set of planes
+struct Quadric {
+    double a[10];
+
+    Quadric() { memset(a, 0, sizeof(a)); }
+
+    // plane n.p + d = 0 with a unit normal, weighted
+    Quadric(glm::vec3 n, float d, float weight)
+    {
+        double x = n.x, y = n.y, z = n.z, w = d;
+        a[0] = x * x; a[1] = x * y; a[2] = x * z; a[3] = x * w;
+        a[4] = y * y; a[5] = y * z; a[6] = y * w;
+        a[7] = z * z; a[8] = z * w;
+        a[9] = w * w;
+        for (double &value : a)
+            value *= weight;
+    }
+
+    Quadric &operator+=(const Quadric &other)
+    {
+        for (int i = 0; i < 10; i++)
+            a[i] += other.a[i];
+        return *this;
+    }
+
+    double error(glm::vec3 p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+               + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+               + a[7] * z * z + 2 * a[8] * z + a[9];
+    }
+};
+
+// collapses edges of the triangle list until it is down to targetIndexCount indices or nothing
+// can be collapsed without flipping a triangle or tearing a seam/border. error gets the square root of
+// the largest collapse cost (area weighted squared distances), comparable between levels of a mesh.
+inline vector<unsigned int> simplifyMesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                                         size_t targetIndexCount, float &error)
+{
+    size_t vertexCount = vertices.size();
+    size_t triangleCount = indices.size() / 3;
+    vector<unsigned int> triangles(indices.begin(), indices.begin() + triangleCount * 3);
+    error = 0.0f;
+
+    // vertices at the same position belong to one group, groups of more than one lie on a seam
+    struct PositionHash {
+        size_t operator()(const glm::vec3 &p) const
+        {
+            // + 0.0f turns -0 into 0, they compare equal and have to hash equal
+            float coordinates[3] = {p.x + 0.0f, p.y + 0.0f, p.z + 0.0f};
+            uint32_t bits[3];
+            memcpy(bits, coordinates, sizeof(bits));
+            return (size_t) ((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u));
+        }
+    };
+    unordered_map<glm::vec3, unsigned int, PositionHash> positions;
+    vector<unsigned int> group(vertexCount);
+    vector<unsigned int> groupSize;
+    for (size_t v = 0; v < vertexCount; v++) {
+        auto inserted = positions.insert(make_pair(vertices[v].Position, (unsigned int) groupSize.size()));
+        if (inserted.second)
+            groupSize.push_back(0);
+        group[v] = inserted.first->second;
+        groupSize[group[v]]++;
+    }
+    vector<uint8_t> locked(vertexCount, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        locked[v] = groupSize[group[v]] > 1;
+
+    // edges between position groups used by other than exactly two triangles are borders (or worse)
+    unordered_map<uint64_t, unsigned int> edgeUse;
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++) {
+            uint64_t a = group[triangles[t * 3 + k]], b = group[triangles[t * 3 + (k + 1) % 3]];
+            edgeUse[a < b ? (a << 32) | b : (b << 32) | a]++;
+        }
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = triangles[t * 3 + k], b = triangles[t * 3 + (k + 1) % 3];
+            uint64_t ga = group[a], gb = group[b];
+            if (edgeUse[ga < gb ? (ga << 32) | gb : (gb << 32) | ga] != 2)
+                locked[a] = locked[b] = 1;
+        }
+
+    // area weighted plane quadrics, accumulated per position group so seam twins share theirs
+    vector<Quadric> quadrics(groupSize.size());
+    vector<vector<unsigned int>> incident(vertexCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        glm::vec3 p0 = vertices[triangles[t * 3]].Position, p1 = vertices[triangles[t * 3 + 1]].Position, p2 = vertices[triangles[t * 3 + 2]].Position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area > 0.0f) {
+            normal /= area;
+            Quadric plane(normal, -glm::dot(normal, p0), area * 0.5f);
+            for (int k = 0; k < 3; k++)
+                quadrics[group[triangles[t * 3 + k]]] += plane;
+        }
+        for (int k = 0; k < 3; k++)
+            incident[triangles[t * 3 + k]].push_back((unsigned int) t);
+    }
+
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+
+        bool operator<(const Collapse &other) const { return cost > other.cost; } // min heap
+    };
+    vector<unsigned int> version(vertexCount, 0);
+    vector<uint8_t> removed(vertexCount, 0);
+    vector<uint8_t> dead(triangleCount, 0);
+    priority_queue<Collapse> heap;
+    auto consider = [&](unsigned int from, unsigned int to) {
+        if (locked[from] || from == to)
+            return;
+        Quadric sum = quadrics[group[from]];
+        sum += quadrics[group[to]];
+        heap.push(Collapse{std::max(0.0, sum.error(vertices[to].Position)), from, to, version[from], version[to]});
+    };
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++) {
+            consider(triangles[t * 3 + k], triangles[t * 3 + (k + 1) % 3]);
+            consider(triangles[t * 3 + (k + 1) % 3], triangles[t * 3 + k]);
+        }
+
+    vector<unsigned int> fromNeighbours, toNeighbours;
+    auto neighbours = [&](unsigned int v, vector<unsigned int> &out) {
+        out.clear();
+        for (unsigned int t : incident[v])
+            if (!dead[t])
+                for (int k = 0; k < 3; k++)
+                    if (triangles[t * 3 + k] != v)
+                        out.push_back(triangles[t * 3 + k]);
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    };
+
+    size_t alive = triangleCount;
+    double maxCost = 0.0;
+    while (alive * 3 > targetIndexCount && !heap.empty())
+    {
+        Collapse collapse = heap.top();
+        heap.pop();
+        unsigned int from = collapse.from, to = collapse.to;
+        if (removed[from] || removed[to] || collapse.fromVersion != version[from] || collapse.toVersion != version[to])
+            continue;
+
+        // link condition: the only shared neighbours may be the opposite corners of the triangles on
+        // the edge, anything else would pinch the surface into a non-manifold one
+        neighbours(from, fromNeighbours);
+        neighbours(to, toNeighbours);
+        unsigned int shared = 0, edgeTriangles = 0;
+        for (unsigned int v : fromNeighbours)
+            shared += std::binary_search(toNeighbours.begin(), toNeighbours.end(), v);
+        bool adjacent = std::binary_search(fromNeighbours.begin(), fromNeighbours.end(), to);
+        for (unsigned int t : incident[from])
+            if (!dead[t] && (triangles[t * 3] == to || triangles[t * 3 + 1] == to || triangles[t * 3 + 2] == to))
+                edgeTriangles++;
+        if (!adjacent || shared > edgeTriangles)
+            continue;
+
+        // no remaining triangle may flip or collapse to a sliver
+        bool valid = true;
+        for (unsigned int t : incident[from]) {
+            if (dead[t])
+                continue;
+            unsigned int *corner = &triangles[t * 3];
+            if (corner[0] == to || corner[1] == to || corner[2] == to)
+                continue;
+            glm::vec3 before[3], after[3];
+            for (int k = 0; k < 3; k++) {
+                before[k] = vertices[corner[k]].Position;
+                after[k] = corner[k] == from ? vertices[to].Position : before[k];
+            }
+            glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(oldNormal, newNormal) <= 0.2f * glm::length(oldNormal) * glm::length(newNormal)) {
+                valid = false;
+                break;
+            }
+        }
+        if (!valid)
+            continue;
+
+        for (unsigned int t : incident[from]) {
+            if (dead[t])
+                continue;
+            unsigned int *corner = &triangles[t * 3];
+            if (corner[0] == to || corner[1] == to || corner[2] == to) {
+                dead[t] = 1;
+                alive--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+                if (corner[k] == from)
+                    corner[k] = to;
+            incident[to].push_back(t);
+        }
+        removed[from] = 1;
+        quadrics[group[to]] += quadrics[group[from]];
+        version[to]++;
+        maxCost = std::max(maxCost, collapse.cost);
+
+        // only the costs of edges at to changed, the ones queued before are stale through its version
+        neighbours(to, toNeighbours);
+        for (unsigned int v : toNeighbours) {
+            consider(v, to);
+            consider(to, v);
+        }
+    }
+
+    vector<unsigned int> result;
+    result.reserve(alive * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+        if (!dead[t])
+            result.insert(result.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+    error = (float) std::sqrt(maxCost);
+    return result;
+}
+
+// appends up to MESH_LOD_LEVELS simplified levels to the mesh's index buffer and records the ranges of
+// all levels, the base mesh first. Stops early once a level can't get below 80% of the one before.
+inline void generateLodChain(MeshData &mesh)
+{
+    mesh.lods.clear();
+    MeshLod base;
+    base.firstIndex = 0;
+    base.indexCount = (uint32_t) mesh.indices.size();
+    base.error = 0.0f;
+    mesh.lods.push_back(base);
+
+    vector<unsigned int> previous = mesh.indices;
+    for (unsigned int level = 0; level < MESH_LOD_LEVELS; level++)
+    {
+        float error;
+        vector<unsigned int> simplified = simplifyMesh(mesh.vertices, previous, previous.size() / 2 / 3 * 3, error);
+        if (simplified.empty() || simplified.size() > previous.size() * 4 / 5)
+            break;
+        optimizeVertexCache(simplified, mesh.vertices.size());
+        MeshLod lod;
+        lod.firstIndex = (uint32_t) mesh.indices.size();
+        lod.indexCount = (uint32_t) simplified.size();
+        lod.error = std::max(error, mesh.lods.back().error);
+        mesh.lods.push_back(lod);
+        mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+        previous.swap(simplified);
+    }
+}
+#endif
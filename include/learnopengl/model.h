@@ -10,66 +10,404 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/frustum_culler.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/software_occlusion.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/thread_pool.h>
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <iomanip>
+#include <future>
 #include <map>
+#include <memory>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// post-processing applied to every imported model; part of the mesh cache key.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
 
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    bool optimizeMeshes;    // run the import-time optimization pass from mesh_optimizer.h on a cache miss
+    VertexFormat vertexFormat;
+    unsigned int occluderBudget;    // triangles kept for Occluder(), 0 for models that don't occlude anything
+    bool generateLods;      // build a chain of simplified levels per mesh on a cache miss, see mesh_simplifier.h
+    glm::vec2 impostorFade; // distance band over which Submit's draws dither out into an Impostor, none while y is 0
+
+    // default constructor, the model is filled in later through LoadAsync and Upload.
+    Model() : gammaCorrection(false), optimizeMeshes(true), vertexFormat(VERTEX_COMPACT), occluderBudget(0), generateLods(false), impostorFade(0.0f)
+    {
+    }
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false)
+        : gammaCorrection(gamma), optimizeMeshes(true), vertexFormat(VERTEX_COMPACT), occluderBudget(0), generateLods(false), impostorFade(0.0f)
     {
-        loadModel(path);
+        Import(path);
+        Upload();
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // an import still running on the pool writes into this model, so it has to finish first.
+    // every mesh texture holds a reference in the texture loader, given back here
+    ~Model()
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        if (importing.valid())
+            importing.wait();
+        for (const Mesh &mesh : meshes)
+            for (const Texture &texture : mesh.textures)
+                textureLoader().release(texture.id);
     }
 
-    void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
-        }
+    // starts importing the model on the worker pool, Upload has to be called on the GL thread to finish loading.
+    void LoadAsync(string const &path, bool gamma = false)
+    {
+        gammaCorrection = gamma;
+        importing = workerPool().submit([this, path] { Import(path); });
     }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // CPU half of loading: maps the mesh cache (or runs ASSIMP on a cache miss) and prefetches
+    // every referenced texture on the worker pool. Touches no GL state, so it is safe on any thread.
+    // the post-processed meshes are cached on disk, so a warm start maps the cache and never touches ASSIMP.
+    void Import(string const &path)
     {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        unsigned int options = (optimizeMeshes ? MESH_CACHE_OPTIMIZED : 0) | (vertexFormat == VERTEX_COMPACT ? MESH_CACHE_COMPACT_VERTICES : 0)
+                               | (generateLods ? MESH_CACHE_LODS : 0);
+        cache.reset(new MeshCache(path, MODEL_IMPORT_FLAGS, options));
+        if (cache->load())
+        {
+            for (unsigned int i = 0; i < cache->meshCount(); i++)
+                for (unsigned int j = 0; j < cache->mesh(i).textureCount; j++)
+                    prefetchTexture(cache->texture(i, j).path);
+            if (occluderBudget)
+            {
+                for (unsigned int i = 0; i < cache->meshCount(); i++)
+                    appendTriangles(occluder, cache->vertices(i), cache->mesh(i).encoding, cache->indices(i), cache->mesh(i).indexType,
+                                    cache->mesh(i).lodCount ? cache->mesh(i).lods[0].indexCount : cache->mesh(i).indexCount);
+                keepLargestTriangles(occluder, occluderBudget);
+            }
+            return;
+        }
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            cache.reset();
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+        if (optimizeMeshes)
+        {
+            MeshOptimizerStats stats;
+            for (MeshData &data : imported)
+                optimizeMesh(data, stats);
+            // one write per report, the models import in parallel and would interleave otherwise
+            ostringstream report;
+            report << fixed << setprecision(2) << "Mesh optimizer: " << path << ", " << stats.meshes << " meshes, vertices "
+                   << stats.verticesBefore << " -> " << stats.verticesAfter << ", ACMR " << stats.acmrBefore() << " -> " << stats.acmrAfter()
+                   << setprecision(1) << ", buffers " << stats.bytesBefore / 1024.0 << " KB -> " << stats.bytesAfter / 1024.0 << " KB\n";
+            cout << report.str();
+        }
+        if (generateLods)
+        {
+            // one line for the whole model: triangles of every level summed over the meshes (a mesh with a
+            // shorter chain counts its coarsest level), and the largest error of the level
+            vector<unsigned int> triangles;
+            vector<float> errors;
+            for (MeshData &data : imported)
+            {
+                generateLodChain(data);
+                if (data.lods.size() > triangles.size()) {
+                    triangles.resize(data.lods.size(), 0);
+                    errors.resize(data.lods.size(), 0.0f);
+                }
+            }
+            for (const MeshData &data : imported)
+                for (size_t lod = 0; lod < triangles.size() && !data.lods.empty(); lod++)
+                {
+                    const MeshLod &level = data.lods[std::min(lod, data.lods.size() - 1)];
+                    triangles[lod] += level.indexCount / 3;
+                    errors[lod] = std::max(errors[lod], level.error);
+                }
+            ostringstream report;
+            report << setprecision(3) << "LOD chain: " << path << ", " << imported.size() << " meshes, "
+                   << (triangles.empty() ? 0 : triangles[0]) << " triangles";
+            for (size_t lod = 1; lod < triangles.size(); lod++)
+                report << " -> " << triangles[lod] << " (error " << errors[lod] << ")";
+            report << "\n";
+            cout << report.str();
+        }
+        if (vertexFormat == VERTEX_COMPACT)
+        {
+            size_t before = 0, after = 0;
+            for (MeshData &data : imported)
+            {
+                before += data.vertices.size() * sizeof(Vertex);
+                data.quantize();
+                after += data.compactVertices.size() * sizeof(CompactVertex);
+            }
+            ostringstream report;
+            report << fixed << setprecision(1) << "Vertex format: " << path << ", compact vertices "
+                   << before / 1024.0 << " KB -> " << after / 1024.0 << " KB\n";
+            cout << report.str();
+        }
+        if (occluderBudget)
+        {
+            for (const MeshData &data : imported)
+                appendTriangles(occluder, data.vertexData(), data.encoding, data.indices.data(), GL_UNSIGNED_INT,
+                                data.lods.empty() ? data.indices.size() : data.lods[0].indexCount);
+            keepLargestTriangles(occluder, occluderBudget);
+        }
+        cache->store(imported);
+        cache.reset();
+    }
+
+    // GL half of loading: waits for a pending LoadAsync, then creates the mesh buffers. Textures are
+    // handed to the texture loader and stream in over the following frames.
+    void Upload()
+    {
+        if (importing.valid())
+            importing.get();
+
+        if (cache)
+        {
+            // warm start, vertex and index buffers are filled straight from the mapping
+            for (unsigned int i = 0; i < cache->meshCount(); i++)
+            {
+                const MeshCacheRecord &record = cache->mesh(i);
+                vector<Texture> textures;
+                for (unsigned int j = 0; j < record.textureCount; j++)
+                    textures.push_back(loadMaterialTexture(cache->texture(i, j).path, cache->texture(i, j).type));
+                meshes.push_back(Mesh(cache->vertices(i), record.vertexCount, record.encoding, record.bounds,
+                                      cache->indices(i), record.indexType, record.indexCount, textures, record.lods, record.lodCount));
+            }
+            cache.reset();
+        }
+        for (MeshData &data : imported)
+        {
+            vector<Texture> textures;
+            for (const Texture &texture : data.textures)
+                textures.push_back(loadMaterialTexture(texture.path.c_str(), texture.type));
+            GLenum indexType = indexTypeFor(data.vertexCount());
+            vector<unsigned short> shortIndices;
+            meshes.push_back(Mesh(data.vertexData(), data.vertexCount(), data.encoding, data.bounds,
+                                  indicesAs(indexType, data.indices, shortIndices), indexType, data.indices.size(), textures,
+                                  data.lods.data(), (unsigned int) data.lods.size()));
+        }
+        imported.clear();
+    }
+
+    // draws the model, and thus all its meshes
+    void Draw(Shader &shader)
+    {
+        static constexpr UniformId INSTANCED("instanced");
+        shader.setBool(INSTANCED, false);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(shader);
+    }
+
+    // draws the model once per transform with a single instanced draw call per mesh, the shader
+    // reads the model matrix from the per-instance attribute instead of the "model" uniform.
+    void DrawInstanced(Shader &shader, const vector<glm::mat4> &transforms)
+    {
+        if (transforms.empty())
+            return;
+        uploadInstances(transforms);
+
+        static constexpr UniformId INSTANCED("instanced");
+        shader.setBool(INSTANCED, true);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, (unsigned int) transforms.size());
+        shader.setBool(INSTANCED, false);
+    }
+
+    // queues instanced draws instead of drawing right away, with only the placements whose bounds
+    // intersect the frustum. The visible transforms of each mesh are packed back to back and written
+    // into the queue's stream buffer right away. Only if that is full they go into the model's own
+    // instance buffer, which then holds one submission per frame.
+    // occlusionQueries optionally gives a query per transform (0 for none); placements sharing a query
+    // go out as one draw conditional on it. lods optionally gives the level of detail per transform,
+    // see LodSelector. Each mesh gets one draw per distinct query and level.
+    // The depth key of a draw is its nearest visible placement. Every mesh is drawn with the variant
+    // of shaders its textures and the model's impostor fade call for.
+    void Submit(RenderQueue &queue, FrustumCuller &culler, ShaderVariants &shaders, const vector<glm::mat4> &transforms,
+                const vector<unsigned int> *occlusionQueries = nullptr, const vector<unsigned int> *lods = nullptr,
+                RenderPass pass = PASS_OPAQUE)
+    {
+        Prepare(queue, culler, transforms, occlusionQueries, lods);
+        SubmitPrepared(queue, shaders, pass);
+    }
+
+    // the CPU half of Submit: culls and groups the draws without touching GL, so different models can
+    // be prepared on worker threads at the same time, each with a culler of its own
+    void Prepare(const RenderQueue &queue, FrustumCuller &culler, const vector<glm::mat4> &transforms,
+                 const vector<unsigned int> *occlusionQueries = nullptr, const vector<unsigned int> *lods = nullptr)
+    {
+        visibleTransforms.clear();
+        meshRanges.clear();
+        if (transforms.empty())
+            return;
+        culler.clear();
+        for (Mesh &mesh : meshes)
+            for (const glm::mat4 &transform : transforms)
+                culler.add(transform, mesh.bounds);
+        culler.cull();
+
+        unsigned int box = 0;
+        vector<unsigned int> &visible = visibleIndices;
+        for (unsigned int i = 0; i < meshes.size(); i++, box += (unsigned int) transforms.size())
+        {
+            visible.clear();
+            for (unsigned int t = 0; t < transforms.size(); t++)
+                if (culler.visible(box + t))
+                    visible.push_back(t);
+            unsigned int lastLod = meshes[i].lodCount - 1;
+            auto lodOf = [lods, lastLod](unsigned int t) { return lods ? std::min((*lods)[t], lastLod) : 0u; };
+            if (occlusionQueries || lods)
+                std::stable_sort(visible.begin(), visible.end(), [occlusionQueries, &lodOf](unsigned int a, unsigned int b) {
+                    unsigned int queryA = occlusionQueries ? (*occlusionQueries)[a] : 0, queryB = occlusionQueries ? (*occlusionQueries)[b] : 0;
+                    return queryA != queryB ? queryA < queryB : lodOf(a) < lodOf(b);
+                });
+            for (unsigned int v = 0; v < visible.size(); v++)
+            {
+                unsigned int t = visible[v];
+                unsigned int query = occlusionQueries ? (*occlusionQueries)[t] : 0;
+                unsigned int lod = lodOf(t);
+                if (v == 0 || query != meshRanges.back().query || lod != meshRanges.back().lod) {
+                    MeshRange range;
+                    range.mesh = i;
+                    range.first = (unsigned int) visibleTransforms.size();
+                    range.count = 0;
+                    range.depth = 0xffffffffu;
+                    range.query = query;
+                    range.lod = lod;
+                    meshRanges.push_back(range);
+                }
+                MeshRange &range = meshRanges.back();
+                visibleTransforms.push_back(transforms[t]);
+                range.count++;
+                range.depth = std::min(range.depth, queue.depthKey(culler.center(box + t)));
+            }
+        }
+    }
+
+    // the GL half of Submit, on the GL thread: streams the draws of the last Prepare and queues them.
+    // With the queue's depth prepass on, depthShaders (the same vertex shader as shaders, with a depth
+    // only fragment shader) draw every range into the prepass as well.
+    void SubmitPrepared(RenderQueue &queue, ShaderVariants &shaders, RenderPass pass = PASS_OPAQUE, ShaderVariants *depthShaders = nullptr)
+    {
+        if (visibleTransforms.empty())
+            return;
+        // into the queue's per-frame stream, or this model's own buffer if the stream ran out of room
+        unsigned int buffer = queue.stream().buffer();
+        int first = queue.streamInstances(visibleTransforms);
+        if (first < 0) {
+            uploadInstances(visibleTransforms, false);
+            buffer = instanceVBO;
+            first = 0;
+        }
+
+        bool prepassed = depthShaders && queue.depthPrepass();
+        uint32_t modelFeatures = impostorFade.y > 0.0f ? (uint32_t) FEATURE_IMPOSTOR_FADE : 0u;
+        for (const MeshRange &range : meshRanges)
+        {
+            Mesh &mesh = meshes[range.mesh];
+            uint32_t features = mesh.shaderFeatures | modelFeatures;
+            if (prepassed)
+                queue.submit(depthPassOf(pass), depthShaders->get(features), mesh, buffer, first + range.first, range.count, range.depth,
+                             range.query, range.lod, impostorFade);
+            queue.submit(pass, shaders.get(features), mesh, buffer, first + range.first, range.count, range.depth, range.query, range.lod,
+                         impostorFade, prepassed);
+        }
+    }
+
+    // levels of detail of the most detailed mesh, 1 without a LOD chain
+    unsigned int LodCount() const
+    {
+        unsigned int count = 1;
+        for (const Mesh &mesh : meshes)
+            count = std::max(count, mesh.lodCount);
+        return count;
+    }
+
+    // object space box around all meshes, empty before Upload
+    Aabb Bounds() const
+    {
+        Aabb bounds;
+        for (const Mesh &mesh : meshes)
+            bounds.merge(Aabb(mesh.bounds));
+        return bounds;
+    }
+
+    // reduced triangle soup of the model for SoftwareOcclusion, in object space; empty unless
+    // occluderBudget was set before loading
+    const vector<glm::vec3> &Occluder() const { return occluder; }
+
+    void SetShaderTextureNamePrefix(std::string prefix) {
+        for (Mesh& mesh: meshes) {
+            mesh.SetTextureNamePrefix(prefix);
+        }
+    }
+private:
+    unsigned int instanceVBO = 0;           // per-instance model matrices for DrawInstanced and Submit
+    vector<glm::vec3> occluder;
+
+    // Submit's per-frame scratch: the visible transforms of every mesh back to back, split into one range per draw
+    struct MeshRange {
+        unsigned int mesh;
+        unsigned int first, count;
+        uint32_t depth;
+        unsigned int query;
+        unsigned int lod;
+    };
+    vector<glm::mat4> visibleTransforms;
+    vector<MeshRange> meshRanges;
+    vector<unsigned int> visibleIndices;
+
+    // state handed from Import to Upload
+    future<void> importing;
+    unique_ptr<MeshCache> cache;            // set on a cache hit, the meshes are read out of its mapping
+    vector<MeshData> imported;              // set on a cache miss, the meshes as processed from ASSIMP
+
+    // fills the per-instance model matrix buffer shared by all meshes, shared points every mesh at its start
+    void uploadInstances(const vector<glm::mat4> &transforms, bool shared = true)
+    {
+        if (instanceVBO == 0)
+            glGenBuffers(1, &instanceVBO);
+        if (shared)
+            for (Mesh &mesh : meshes)
+                mesh.SetInstanceBuffer(instanceVBO);
+        // orphan and refill, the transforms may change from frame to frame
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, transforms.size() * sizeof(glm::mat4), transforms.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -81,7 +419,7 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            imported.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
@@ -91,17 +429,20 @@ private:
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            // value-initialized, the attributes a mesh doesn't have are zero instead of stack garbage
+            // (the welding, the quantized tangents and the mesh cache all see every attribute)
+            Vertex vertex{};
             glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -137,12 +478,18 @@ private:
                 vertex.Bitangent = vector;
             }
             else
+            {
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
 
             vertices.push_back(vertex);
 
 
         }
+        // bounding box and sphere for culling, before the optimizer and quantization touch the vertices
+        data.bounds = computeMeshBounds(vertices);
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
@@ -178,12 +525,12 @@ private:
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, uploaded once the whole model has been processed
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
+    // checks all material textures of a given type and prefetches their images.
+    // the required info is returned as Texture structs, their ids are filled in by Upload.
     vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
@@ -191,69 +538,42 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            prefetchTexture(texture.path);
+            textures.push_back(texture);
         }
         return textures;
     }
+
+    // starts decoding the image at the given material path on the worker pool.
+    void prefetchTexture(const string &path)
+    {
+        textureLoader().prefetch(directory + '/' + path);
+    }
+
+    // returns the texture at the given material path. The texture loader shares one handle per file
+    // (and per distinct image content) across every model, each call takes a reference that ~Model gives back.
+    Texture loadMaterialTexture(const char *path, const string &typeName)
+    {
+        Texture texture;
+        texture.id = TextureFromFile(path, this->directory, gammaCorrection);
+        texture.type = typeName;
+        texture.path = path;
+        return texture;
+    }
 };
 
 
+// returns a texture loader handle right away, the image is decoded and uploaded in the background.
+// bind it through textureLoader().name(handle), see texture_loader.h.
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return textureLoader().load(filename);
 }
 #endif
@@ -0,0 +1,150 @@
+#ifndef OCCLUSION_QUERIES_H
+#define OCCLUSION_QUERIES_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/frustum_culler.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader.h>
+
+#include <vector>
+using namespace std;
+
+// Hardware occlusion culling for groups of draws (an island's props).
+//
+// Every volume has a box and a GL_ANY_SAMPLES_PASSED query. issue() draws the boxes against the
+// depth buffer of the opaque pass, without color or depth writes. The next frame the draws of a volume
+// are wrapped in glBeginConditionalRender on its query (see RenderQueue), so the GPU skips them when
+// no sample of the box passed. The CPU never reads a result back: with GL_QUERY_NO_WAIT a result that
+// isn't in yet just means the draw happens.
+//
+// A query is only used the frame right after it was issued and never while the camera is inside
+// or right next to the box, where the box faces get clipped away and would report it hidden.
+class OcclusionQueries
+{
+public:
+    OcclusionQueries() : enabled(true), frame(0), viewPosition(0.0f), issuedCount(0)
+    {
+        // unit cube around the origin, scaled onto each box in occlusion_box.vs
+        float cubeVertices[] = {
+                -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,   0.5f,  0.5f, -0.5f,
+                 0.5f,  0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,  -0.5f, -0.5f, -0.5f,
+                -0.5f, -0.5f,  0.5f,   0.5f,  0.5f,  0.5f,   0.5f, -0.5f,  0.5f,
+                 0.5f,  0.5f,  0.5f,  -0.5f, -0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,
+                -0.5f,  0.5f,  0.5f,  -0.5f,  0.5f, -0.5f,  -0.5f, -0.5f, -0.5f,
+                -0.5f, -0.5f, -0.5f,  -0.5f, -0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,
+                 0.5f,  0.5f,  0.5f,   0.5f, -0.5f, -0.5f,   0.5f,  0.5f, -0.5f,
+                 0.5f, -0.5f, -0.5f,   0.5f,  0.5f,  0.5f,   0.5f, -0.5f,  0.5f,
+                -0.5f, -0.5f, -0.5f,   0.5f, -0.5f,  0.5f,   0.5f, -0.5f, -0.5f,
+                 0.5f, -0.5f,  0.5f,  -0.5f, -0.5f, -0.5f,  -0.5f, -0.5f,  0.5f,
+                -0.5f,  0.5f, -0.5f,   0.5f,  0.5f, -0.5f,   0.5f,  0.5f,  0.5f,
+                 0.5f,  0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,  -0.5f,  0.5f, -0.5f
+        };
+        glGenVertexArrays(1, &cubeVAO);
+        glGenBuffers(1, &cubeVBO);
+        glState().bindVertexArray(cubeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glState().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~OcclusionQueries()
+    {
+        for (const Volume &volume : volumes)
+            glDeleteQueries(1, &volume.query);
+        glState().deleteVertexArray(cubeVAO);
+        glDeleteBuffers(1, &cubeVBO);
+    }
+
+    OcclusionQueries(const OcclusionQueries &) = delete;
+    OcclusionQueries &operator=(const OcclusionQueries &) = delete;
+
+    // adds a volume, returns its index for setBounds/condition
+    unsigned int addVolume(const Aabb &bounds)
+    {
+        Volume volume;
+        glGenQueries(1, &volume.query);
+        volume.bounds = bounds;
+        volume.issuedFrame = 0;
+        volumes.push_back(volume);
+        return (unsigned int) volumes.size() - 1;
+    }
+
+    // for volumes that move, takes effect with the next issue()
+    void setBounds(unsigned int volume, const Aabb &bounds) { volumes[volume].bounds = bounds; }
+
+    // starts a frame, the queries issued in the last one become usable
+    void begin(glm::vec3 viewPosition, float nearPlane)
+    {
+        frame++;
+        this->viewPosition = viewPosition;
+        this->nearPlane = nearPlane;
+    }
+
+    // query to make the volume's draws this frame conditional on, 0 to draw them unconditionally
+    unsigned int condition(unsigned int volume) const
+    {
+        const Volume &v = volumes[volume];
+        if (!enabled || v.issuedFrame + 1 != frame || cameraInside(v.bounds))
+            return 0;
+        return v.query;
+    }
+
+    // draws the box of every volume in the frustum inside its query. Expects the opaque depth buffer
+    // and the PASS_OCCLUSION state (no color or depth writes, LEQUAL, no culling) with shader bound.
+    void issue(Shader &shader, const FrustumCuller &frustum)
+    {
+        issuedCount = 0;
+        if (!enabled)
+            return;
+        static constexpr UniformId BOX_CENTER("boxCenter");
+        static constexpr UniformId BOX_SIZE("boxSize");
+        glState().bindVertexArray(cubeVAO);
+        for (Volume &volume : volumes)
+        {
+            unsigned int planes = FrustumCuller::ALL_PLANES;
+            if (volume.bounds.empty() || cameraInside(volume.bounds) || frustum.classify(volume.bounds, planes) == FrustumCuller::OUTSIDE)
+                continue;
+            shader.setVec3(BOX_CENTER, volume.bounds.center());
+            shader.setVec3(BOX_SIZE, volume.bounds.maximum - volume.bounds.minimum);
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, volume.query);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            volume.issuedFrame = frame;
+            issuedCount++;
+        }
+    }
+
+    // queries issued in the last issue()
+    unsigned int issued() const { return issuedCount; }
+
+    bool enabled;
+
+private:
+    struct Volume {
+        Aabb bounds;
+        unsigned int query;
+        unsigned int issuedFrame;
+    };
+
+    vector<Volume> volumes;
+    unsigned int cubeVAO, cubeVBO;
+    unsigned int frame;
+    glm::vec3 viewPosition;
+    float nearPlane = 0.1f;
+    unsigned int issuedCount;
+
+    // the box grown by a margin over the near plane, the near plane would clip the box faces before
+    // the camera is strictly inside
+    bool cameraInside(const Aabb &bounds) const
+    {
+        return bounds.distanceSquared(viewPosition) <= (2.0f * nearPlane) * (2.0f * nearPlane);
+    }
+};
+#endif
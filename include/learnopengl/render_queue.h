@@ -0,0 +1,434 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/indirect_draw.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_arena.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/stream_buffer.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+using namespace std;
+
+// passes in execution order, each one sets up its own fixed function state
+enum RenderPass {
+    PASS_DEPTH_OPAQUE = 0,          // depth prepass of the opaque draws, no color writes
+    PASS_DEPTH_ALPHA_TESTED = 1,    // depth prepass of the cutouts, double sided
+    PASS_OPAQUE = 2,                // back face culled, front to back
+    PASS_OCCLUSION = 3,             // occlusion query proxies against the opaque depth, no color or depth writes
+    PASS_ALPHA_TESTED = 4,          // double sided cutouts like the grass, front to back
+    PASS_SKY = 5,                   // drawn behind everything with depth func LEQUAL
+    RENDER_PASS_COUNT
+};
+
+// the depth prepass that goes with a color pass, with the same culling
+inline RenderPass depthPassOf(RenderPass pass)
+{
+    return pass == PASS_ALPHA_TESTED ? PASS_DEPTH_ALPHA_TESTED : PASS_DEPTH_OPAQUE;
+}
+
+// 64-bit sort key, most significant field first:
+//   63-60 pass
+//   59-48 shader program
+//   47-24 material (hash of the texture set)
+//   23-0  view distance, quantized
+// Sorting by it groups draws by shader, then by textures, and draws each group front to back so
+// early-Z rejects as much as possible. The fields only decide the order, the draw itself comes
+// from the payload, so truncated ids that collide cost a state change but never a wrong draw.
+inline uint64_t makeSortKey(RenderPass pass, unsigned int shader, uint32_t material, uint32_t depth)
+{
+    return ((uint64_t) (pass & 0xf) << 60) | ((uint64_t) (shader & 0xfff) << 48) |
+           ((uint64_t) (material & 0xffffff) << 24) | (uint64_t) (depth & 0xffffff);
+}
+
+// Draws collected over a frame and executed in key order.
+//
+// Usage per frame: begin() with the camera, submit everything (Model::Submit for models, a callback
+// for anything else), then execute(). The queue keeps its storage between frames.
+//
+// The frame's instance matrices are written into stream(), a ring of per-frame regions, and draws
+// point at them by offset (see Model::Submit).
+//
+// With the multi-draw-indirect backend (meshes in meshArena()), neighbouring mesh draws that share
+// shader, textures, arena pool, instance buffer and occlusion query go out as one
+// glMultiDrawElementsIndirect. The shader then has to be the indirect variant of the model shader,
+// which reads each draw's position decoding from the DrawData storage buffer through gl_DrawID.
+//
+// With the depth prepass on (setDepthPrepass), submitters also queue a depth only version of their
+// draws into depthPassOf(pass), and mark the color draw as prepassed. Prepassed draws of the opaque
+// and alpha tested passes then run with GL_EQUAL and without depth writes, so every pixel is shaded
+// once, by the surface that ends up visible. Draws that can't reproduce their depth exactly (the
+// impostors write gl_FragDepth) stay unmarked and keep the usual GL_LESS.
+class RenderQueue
+{
+public:
+    RenderQueue() : viewPosition(0.0f), farPlane(100.0f), prepass(false), indirectBuffer(0), drawDataBuffer(0), drawCalls(0), commandOffset(0)
+    {
+    }
+
+    ~RenderQueue()
+    {
+        if (indirectBuffer)
+            glDeleteBuffers(1, &indirectBuffer);
+        if (drawDataBuffer)
+            glDeleteBuffers(1, &drawDataBuffer);
+    }
+
+    RenderQueue(const RenderQueue &) = delete;
+    RenderQueue &operator=(const RenderQueue &) = delete;
+
+    // starts a new frame, depth keys are distances from viewPosition scaled to [0, farPlane]
+    void begin(glm::vec3 viewPosition, float farPlane)
+    {
+        streamBuffer.beginFrame();
+        this->viewPosition = viewPosition;
+        this->farPlane = farPlane;
+        items.clear();
+        callbacks.clear();
+        keys.clear();
+    }
+
+    // whether submitters should queue the depth prepass, see above. Only read at submit time.
+    void setDepthPrepass(bool enabled) { prepass = enabled; }
+    bool depthPrepass() const { return prepass; }
+
+    // quantized distance from the camera, the depth field of the sort key
+    uint32_t depthKey(glm::vec3 position) const
+    {
+        float distance = glm::length(position - viewPosition) / farPlane;
+        return (uint32_t) (std::min(std::max(distance, 0.0f), 1.0f) * 16777215.0f);
+    }
+
+    // instanced draw of mesh with the model matrices firstInstance.. of instanceBuffer, which has to keep
+    // them until execute(). A non-zero occlusionQuery makes it a conditional draw on that query's result.
+    // lod picks the mesh's level of detail, impostorFade is the band the mesh dithers out over (see impostor.h).
+    // prepassed says the same draw went into the depth prepass, the color draw then tests GL_EQUAL.
+    void submit(RenderPass pass, Shader &shader, Mesh &mesh, unsigned int instanceBuffer, unsigned int firstInstance,
+                unsigned int instanceCount, uint32_t depth, unsigned int occlusionQuery = 0, unsigned int lod = 0,
+                glm::vec2 impostorFade = glm::vec2(0.0f), bool prepassed = false)
+    {
+        if (instanceCount == 0)
+            return;
+        RenderItem item;
+        item.shader = &shader;
+        item.mesh = &mesh;
+        item.instanceBuffer = instanceBuffer;
+        item.firstInstance = firstInstance;
+        item.instanceCount = instanceCount;
+        item.occlusionQuery = occlusionQuery;
+        item.lod = lod;
+        item.impostorFade = impostorFade;
+        item.prepassed = prepassed;
+        item.callback = 0;
+        push(makeSortKey(pass, shader.ID, mesh.materialKey, depth), item);
+    }
+
+    // anything that isn't a mesh, draw is called with shader bound and the pass state set
+    void submit(RenderPass pass, Shader &shader, uint32_t material, uint32_t depth, function<void()> draw, bool prepassed = false)
+    {
+        RenderItem item;
+        item.shader = &shader;
+        item.mesh = nullptr;
+        item.instanceBuffer = item.firstInstance = item.instanceCount = 0;
+        item.occlusionQuery = item.lod = 0;
+        item.impostorFade = glm::vec2(0.0f);
+        item.prepassed = prepassed;
+        item.callback = (unsigned int) callbacks.size();
+        callbacks.push_back(std::move(draw));
+        push(makeSortKey(pass, shader.ID, material, depth), item);
+    }
+
+    // sorts the frame's draws and issues them
+    void execute()
+    {
+        sortKeys();
+        batches.clear();
+        if (indirectDraw().available())
+            buildBatches();
+        streamBuffer.flush();
+
+        static constexpr UniformId INSTANCED("instanced");
+        static constexpr UniformId IMPOSTOR_FADE("impostorFade");
+        int pass = -1;
+        bool depthEqual = false;
+        Shader *bound = nullptr;
+        unsigned int batch = 0;
+        drawCalls = 0;
+        for (size_t k = 0; k < keys.size(); k++)
+        {
+            const SortEntry &entry = keys[k];
+            int itemPass = (int) (entry.key >> 60);
+            if (itemPass != pass) {
+                pass = itemPass;
+                setPassState((RenderPass) pass);
+                depthEqual = false;
+            }
+            const RenderItem &item = items[entry.item];
+            if (item.prepassed != depthEqual && (pass == PASS_OPAQUE || pass == PASS_ALPHA_TESTED)) {
+                // the prepass already wrote this draw's depth, only the fragments that match it get shaded
+                depthEqual = item.prepassed;
+                glState().depthFunc(depthEqual ? GL_EQUAL : GL_LESS);
+                glState().depthMask(!depthEqual);
+            }
+            if (item.shader != bound) {
+                item.shader->use();
+                bound = item.shader;
+            }
+            if (item.mesh) {
+                item.shader->setBool(INSTANCED, true);
+                item.shader->setVec2(IMPOSTOR_FADE, item.impostorFade);
+                // with GL_QUERY_NO_WAIT the draw goes ahead if the query result isn't in yet, so this never stalls
+                if (item.occlusionQuery)
+                    glBeginConditionalRender(item.occlusionQuery, GL_QUERY_NO_WAIT);
+                if (batch < batches.size() && batches[batch].first == k) {
+                    drawBatch(batches[batch], item);
+                    k = batches[batch++].end - 1;
+                } else {
+                    item.mesh->SetInstanceBuffer(item.instanceBuffer, item.firstInstance);
+                    item.mesh->DrawInstanced(*item.shader, item.instanceCount, item.lod);
+                }
+                if (item.occlusionQuery)
+                    glEndConditionalRender();
+                drawCalls++;
+            } else {
+                callbacks[item.callback]();
+            }
+        }
+        // back to the defaults the rest of the frame expects: no culling, depth writes and LESS
+        setPassState(PASS_ALPHA_TESTED);
+        streamBuffer.endFrame();
+    }
+
+    unsigned int size() const { return (unsigned int) keys.size(); }
+
+    // per-frame data written between begin() and execute(), read by this frame's draws
+    StreamBuffer &stream() { return streamBuffer; }
+
+    // copies matrices into the stream, returns the index of the first one in stream().buffer(), or
+    // -1 if the frame's region is full
+    int streamInstances(const vector<glm::mat4> &transforms)
+    {
+        StreamBuffer::Allocation allocation = streamBuffer.allocate(transforms.size() * sizeof(glm::mat4), sizeof(glm::mat4));
+        if (!allocation.data)
+            return -1;
+        memcpy(allocation.data, transforms.data(), transforms.size() * sizeof(glm::mat4));
+        return (int) (allocation.offset / sizeof(glm::mat4));
+    }
+
+    // GL draw calls the last execute() made for meshes, one per batch with the indirect backend
+    unsigned int meshDrawCalls() const { return drawCalls; }
+
+private:
+    // payload of a key, referenced by index so the sort only moves 16 byte entries
+    struct RenderItem {
+        Shader *shader;
+        Mesh *mesh;                 // null for callback draws
+        unsigned int instanceBuffer, firstInstance, instanceCount;
+        unsigned int occlusionQuery;
+        unsigned int lod;
+        glm::vec2 impostorFade;
+        bool prepassed;             // drawn into the depth prepass as well
+        unsigned int callback;      // index into callbacks when mesh is null
+    };
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    // keys first..end-1 drawn by one multi-draw, with the commands from firstCommand on
+    struct IndirectBatch {
+        size_t first, end;
+        unsigned int firstCommand;
+    };
+
+    glm::vec3 viewPosition;
+    float farPlane;
+    bool prepass;
+    vector<RenderItem> items;
+    vector<function<void()>> callbacks;
+    vector<SortEntry> keys;
+    vector<SortEntry> scratch;
+    vector<IndirectBatch> batches;
+    vector<DrawElementsIndirectCommand> commands;
+    vector<glm::vec4> drawData;             // per command: position scale, position offset
+    unsigned int indirectBuffer, drawDataBuffer;   // used when the stream is full
+    unsigned int drawCalls;
+    StreamBuffer streamBuffer;
+    size_t commandOffset;                   // byte offset of commands[0] in the bound GL_DRAW_INDIRECT_BUFFER
+
+    void push(uint64_t key, const RenderItem &item)
+    {
+        SortEntry entry;
+        entry.key = key;
+        entry.item = (uint32_t) items.size();
+        items.push_back(item);
+        keys.push_back(entry);
+    }
+
+    // groups the sorted mesh draws of the arena into batches and uploads their commands and per-draw
+    // data, both buffers stay bound for the frame
+    void buildBatches()
+    {
+        commands.clear();
+        drawData.clear();
+        for (size_t k = 0; k < keys.size(); k++)
+        {
+            const RenderItem &item = items[keys[k].item];
+            if (!item.mesh || item.mesh->arenaPool < 0)
+                continue;
+            bool joins = !batches.empty() && batches.back().end == k && (keys[k - 1].key >> 60) == (keys[k].key >> 60)
+                         && batchable(items[keys[k - 1].item], item);
+            if (!joins) {
+                IndirectBatch batch;
+                batch.first = k;
+                batch.firstCommand = (unsigned int) commands.size();
+                batches.push_back(batch);
+            }
+            batches.back().end = k + 1;
+            commands.push_back(item.mesh->IndirectCommand(item.instanceCount, item.firstInstance, item.lod));
+            const VertexEncoding &encoding = item.mesh->encoding;
+            drawData.push_back(glm::vec4(encoding.positionScale[0], encoding.positionScale[1], encoding.positionScale[2], 0.0f));
+            drawData.push_back(glm::vec4(encoding.positionOffset[0], encoding.positionOffset[1], encoding.positionOffset[2], 0.0f));
+        }
+        if (commands.empty())
+            return;
+
+        // into the stream like the instances, 256 bytes is the largest storage buffer offset alignment GL allows
+        size_t commandBytes = commands.size() * sizeof(DrawElementsIndirectCommand);
+        size_t drawDataBytes = drawData.size() * sizeof(glm::vec4);
+        StreamBuffer::Allocation commandSpace = streamBuffer.allocate(commandBytes, 16);
+        StreamBuffer::Allocation drawDataSpace = streamBuffer.allocate(drawDataBytes, 256);
+        if (commandSpace.data && drawDataSpace.data) {
+            memcpy(commandSpace.data, commands.data(), commandBytes);
+            memcpy(drawDataSpace.data, drawData.data(), drawDataBytes);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, streamBuffer.buffer());
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, streamBuffer.buffer(), drawDataSpace.offset, drawDataBytes);
+            commandOffset = commandSpace.offset;
+            return;
+        }
+        if (!indirectBuffer) {
+            glGenBuffers(1, &indirectBuffer);
+            glGenBuffers(1, &drawDataBuffer);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBytes, commands.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, drawDataBytes, drawData.data(), GL_STREAM_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawDataBuffer);
+        commandOffset = 0;
+    }
+
+    // draws that can share a multi-draw: everything but the geometry, level and instances is the same
+    static bool batchable(const RenderItem &a, const RenderItem &b)
+    {
+        if (a.shader != b.shader || a.mesh->arenaPool != b.mesh->arenaPool || a.instanceBuffer != b.instanceBuffer
+            || a.occlusionQuery != b.occlusionQuery || a.impostorFade != b.impostorFade || a.prepassed != b.prepassed
+            || a.mesh->textures.size() != b.mesh->textures.size())
+            return false;
+        for (size_t i = 0; i < a.mesh->textures.size(); i++)
+            if (a.mesh->textures[i].id != b.mesh->textures[i].id || a.mesh->textures[i].type != b.mesh->textures[i].type)
+                return false;
+        return true;
+    }
+
+    // first is the batch's first item, whose textures all of them share
+    void drawBatch(const IndirectBatch &batch, const RenderItem &first)
+    {
+        static constexpr UniformId DRAW_DATA_BASE("drawDataBase");
+        first.mesh->BindMaterial(*first.shader);
+        first.shader->setInt(DRAW_DATA_BASE, (int) batch.firstCommand);
+        meshArena().setInstanceBuffer(first.mesh->arenaPool, first.instanceBuffer, 0);
+        glState().bindVertexArray(first.mesh->VAO);
+        indirectDraw().multiDrawElements(first.mesh->indexType, commandOffset + batch.firstCommand * sizeof(DrawElementsIndirectCommand),
+                                         (unsigned int) (batch.end - batch.first));
+    }
+
+    // LSD radix sort on the keys, 8 bits per pass. The histograms of all 8 digits are built in one
+    // sweep, and digits where every key falls into the same bucket (most of the high bits, as there
+    // are only a handful of passes and shaders) are skipped. Stable, so equal keys keep submission order.
+    void sortKeys()
+    {
+        size_t count = keys.size();
+        if (count < 2)
+            return;
+        unsigned int histogram[8][256] = {};
+        for (const SortEntry &entry : keys)
+            for (unsigned int digit = 0; digit < 8; digit++)
+                histogram[digit][(entry.key >> (digit * 8)) & 0xff]++;
+
+        scratch.resize(count);
+        for (unsigned int digit = 0; digit < 8; digit++)
+        {
+            unsigned int *buckets = histogram[digit];
+            if (buckets[(keys[0].key >> (digit * 8)) & 0xff] == count)
+                continue;
+            unsigned int offset = 0;
+            for (unsigned int bucket = 0; bucket < 256; bucket++) {
+                unsigned int size = buckets[bucket];
+                buckets[bucket] = offset;
+                offset += size;
+            }
+            for (const SortEntry &entry : keys)
+                scratch[buckets[(entry.key >> (digit * 8)) & 0xff]++] = entry;
+            keys.swap(scratch);
+        }
+    }
+
+    static void setPassState(RenderPass pass)
+    {
+        switch (pass)
+        {
+        case PASS_DEPTH_OPAQUE:
+            glState().setCullFace(true);
+            glState().cullFace(GL_BACK);
+            glState().depthFunc(GL_LESS);
+            glState().depthMask(true);
+            glState().colorMask(false);
+            break;
+        case PASS_DEPTH_ALPHA_TESTED:
+            glState().setCullFace(false);
+            glState().depthFunc(GL_LESS);
+            glState().depthMask(true);
+            glState().colorMask(false);
+            break;
+        case PASS_OPAQUE:
+            glState().setCullFace(true);
+            glState().cullFace(GL_BACK);
+            glState().depthFunc(GL_LESS);
+            glState().depthMask(true);
+            glState().colorMask(true);
+            break;
+        case PASS_OCCLUSION:
+            // boxes are seen from inside too, LEQUAL lets faces touching the geometry count
+            glState().setCullFace(false);
+            glState().depthFunc(GL_LEQUAL);
+            glState().depthMask(false);
+            glState().colorMask(false);
+            break;
+        case PASS_ALPHA_TESTED:
+            glState().setCullFace(false);
+            glState().depthFunc(GL_LESS);
+            glState().depthMask(true);
+            glState().colorMask(true);
+            break;
+        case PASS_SKY:
+            // passes where the depth buffer is still at the far plane
+            glState().setCullFace(false);
+            glState().depthFunc(GL_LEQUAL);
+            break;
+        default:
+            break;
+        }
+    }
+};
+#endif
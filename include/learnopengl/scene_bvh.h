@@ -0,0 +1,338 @@
+#ifndef SCENE_BVH_H
+#define SCENE_BVH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/frustum_culler.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Bounding volume hierarchy over the placed objects of the scene.
+//
+// The hierarchy follows the scene: groups (an island) hold objects (its props) and other groups.
+// build() splits every node with more than MAX_CHILDREN children into a binary tree by the median
+// of their centers along the widest axis, so hundreds of islands at the root still cost a logarithmic
+// number of tests. Every node's box encloses its subtree, so one failed test rejects a whole island.
+//
+// Objects keep their object space box and transform. setTransform() only marks the object, refit()
+// then recomputes its world box and walks up the parents as long as their boxes change.
+// Object ids are handed out in order from 0, callers index their own per-object data with them.
+class SceneBVH
+{
+public:
+    static const unsigned int MAX_CHILDREN = 4;
+
+    struct Stats {
+        unsigned int nodesTested;
+        unsigned int objectsVisible;
+    };
+
+    SceneBVH()
+    {
+        frameStats.nodesTested = frameStats.objectsVisible = 0;
+        nodes.push_back(Node());
+    }
+
+    // the implicit top level group
+    int root() const { return 0; }
+
+    // adds an empty group below parent, returns its node for addObject/addGroup
+    int addGroup(int parent = 0)
+    {
+        return addNode(parent, -1);
+    }
+
+    // places an object with the given object space box below group, returns its object id
+    unsigned int addObject(int group, const Aabb &localBounds, const glm::mat4 &transform)
+    {
+        Object object;
+        object.localBounds = localBounds;
+        object.transform = transform;
+        object.node = addNode(group, (int) objects.size());
+        objects.push_back(object);
+        nodes[object.node].bounds = localBounds.transformed(transform);
+        dirty.push_back((unsigned int) objects.size() - 1);
+        return (unsigned int) objects.size() - 1;
+    }
+
+    void setTransform(unsigned int object, const glm::mat4 &transform)
+    {
+        objects[object].transform = transform;
+        dirty.push_back(object);
+    }
+
+    const glm::mat4 &transform(unsigned int object) const { return objects[object].transform; }
+    const Aabb &worldBounds(unsigned int object) const { return nodes[objects[object].node].bounds; }
+    // world box of a group and everything below it, valid after build()/refit()
+    const Aabb &nodeBounds(int node) const { return nodes[node].bounds; }
+    unsigned int objectCount() const { return (unsigned int) objects.size(); }
+
+    // brings every box up to date and splits wide nodes, call after adding objects
+    void build()
+    {
+        refitNode(root());
+        split(root());
+        dirty.clear();
+    }
+
+    // updates the boxes of moved objects and their ancestors
+    void refit()
+    {
+        for (unsigned int object : dirty)
+        {
+            int node = objects[object].node;
+            nodes[node].bounds = objects[object].localBounds.transformed(objects[object].transform);
+            for (int parent = nodes[node].parent; parent >= 0; parent = nodes[parent].parent)
+            {
+                Aabb bounds = childBounds(parent);
+                if (bounds == nodes[parent].bounds)
+                    break;
+                nodes[parent].bounds = bounds;
+            }
+        }
+        dirty.clear();
+    }
+
+    // appends the ids of all objects whose box intersects the frustum
+    void cull(const FrustumCuller &frustum, vector<unsigned int> &visible)
+    {
+        frameStats.nodesTested = frameStats.objectsVisible = 0;
+        size_t before = visible.size();
+        cullNode(frustum, root(), FrustumCuller::ALL_PLANES, visible, frameStats.nodesTested);
+        frameStats.objectsVisible = (unsigned int) (visible.size() - before);
+    }
+
+    // cull() with the hierarchy split into subtrees that are culled on the worker pool, for scenes
+    // with thousands of objects. Appends the same ids in the same order.
+    void cullParallel(const FrustumCuller &frustum, vector<unsigned int> &visible)
+    {
+        frameStats.nodesTested = frameStats.objectsVisible = 0;
+        size_t before = visible.size();
+
+        // opens up the top of the tree, in depth first order, until there are a couple of subtrees per thread
+        size_t wanted = 2 * (workerPool().size() + 1);
+        subtrees.assign(1, Subtree{root(), FrustumCuller::ALL_PLANES});
+        for (bool opened = true; opened && subtrees.size() < wanted; ) {
+            opened = false;
+            openedSubtrees.clear();
+            for (const Subtree &subtree : subtrees) {
+                const Node &node = nodes[subtree.node];
+                if (node.children.empty()) {
+                    openedSubtrees.push_back(subtree);
+                    continue;
+                }
+                unsigned int planeMask = subtree.planeMask;
+                if (node.bounds.empty())
+                    continue;
+                if (planeMask) {
+                    frameStats.nodesTested++;
+                    if (frustum.classify(node.bounds, planeMask) == FrustumCuller::OUTSIDE)
+                        continue;
+                }
+                for (int child : node.children)
+                    openedSubtrees.push_back(Subtree{child, planeMask});
+                opened = true;
+            }
+            subtrees.swap(openedSubtrees);
+        }
+
+        unsigned int chunks = parallelChunks(subtrees.size(), 1);
+        partialVisible.resize(std::max((size_t) chunks, partialVisible.size()));
+        vector<unsigned int> tested(chunks, 0);
+        parallelFor(subtrees.size(), 1, [this, &frustum, &tested](unsigned int chunk, size_t begin, size_t end) {
+            partialVisible[chunk].clear();
+            for (size_t i = begin; i < end; i++)
+                cullNode(frustum, subtrees[i].node, subtrees[i].planeMask, partialVisible[chunk], tested[chunk]);
+        });
+        for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+            visible.insert(visible.end(), partialVisible[chunk].begin(), partialVisible[chunk].end());
+            frameStats.nodesTested += tested[chunk];
+        }
+        frameStats.objectsVisible = (unsigned int) (visible.size() - before);
+    }
+
+    // appends the ids of all objects whose box overlaps box
+    void queryBox(const Aabb &box, vector<unsigned int> &found) const
+    {
+        queryNode(root(), found, [&box](const Aabb &bounds) { return bounds.overlaps(box); });
+    }
+
+    // appends the ids of all objects whose box is within radius of center
+    void querySphere(glm::vec3 center, float radius, vector<unsigned int> &found) const
+    {
+        float radiusSquared = radius * radius;
+        queryNode(root(), found, [center, radiusSquared](const Aabb &bounds) { return bounds.distanceSquared(center) <= radiusSquared; });
+    }
+
+    // nearest object whose box the ray hits within maxDistance; direction needn't be normalized,
+    // distance is then in units of its length
+    bool raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, unsigned int &object, float &distance) const
+    {
+        glm::vec3 inverse = 1.0f / direction;
+        distance = maxDistance;
+        bool hit = false;
+        raycastNode(root(), origin, inverse, distance, object, hit);
+        return hit;
+    }
+
+    const Stats &stats() const { return frameStats; }
+
+private:
+    struct Node {
+        Aabb bounds;
+        int parent;
+        int object;             // -1 for groups
+        vector<int> children;
+
+        Node() : parent(-1), object(-1) {}
+    };
+
+    struct Object {
+        Aabb localBounds;
+        glm::mat4 transform;
+        int node;
+    };
+
+    vector<Node> nodes;
+    vector<Object> objects;
+    vector<unsigned int> dirty;
+    Stats frameStats;
+
+    // cullParallel's scratch
+    struct Subtree {
+        int node;
+        unsigned int planeMask;     // planes its parent isn't fully inside of
+    };
+    vector<Subtree> subtrees, openedSubtrees;
+    vector<vector<unsigned int>> partialVisible;
+
+    int addNode(int parent, int object)
+    {
+        Node node;
+        node.parent = parent;
+        node.object = object;
+        nodes.push_back(node);
+        int index = (int) nodes.size() - 1;
+        nodes[parent].children.push_back(index);
+        return index;
+    }
+
+    Aabb childBounds(int node) const
+    {
+        Aabb bounds;
+        for (int child : nodes[node].children)
+            bounds.merge(nodes[child].bounds);
+        return bounds;
+    }
+
+    void refitNode(int node)
+    {
+        if (nodes[node].object >= 0) {
+            const Object &object = objects[nodes[node].object];
+            nodes[node].bounds = object.localBounds.transformed(object.transform);
+            return;
+        }
+        for (int child : nodes[node].children)
+            refitNode(child);
+        nodes[node].bounds = childBounds(node);
+    }
+
+    void split(int node)
+    {
+        // copied, addNode below may reallocate nodes
+        vector<int> children = nodes[node].children;
+        for (int child : children)
+            split(child);
+        if (children.size() <= MAX_CHILDREN)
+            return;
+
+        Aabb centers;
+        for (int child : children)
+            centers.merge(Aabb(nodes[child].bounds.center(), nodes[child].bounds.center()));
+        glm::vec3 size = centers.maximum - centers.minimum;
+        int axis = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+        size_t half = children.size() / 2;
+        std::nth_element(children.begin(), children.begin() + half, children.end(), [this, axis](int a, int b) {
+            return nodes[a].bounds.center()[axis] < nodes[b].bounds.center()[axis];
+        });
+
+        nodes[node].children.clear();
+        for (int side = 0; side < 2; side++)
+        {
+            int halfNode = addNode(node, -1);
+            vector<int>::iterator first = side == 0 ? children.begin() : children.begin() + half;
+            vector<int>::iterator last = side == 0 ? children.begin() + half : children.end();
+            for (vector<int>::iterator child = first; child != last; ++child) {
+                nodes[*child].parent = halfNode;
+                nodes[halfNode].children.push_back(*child);
+            }
+            nodes[halfNode].bounds = childBounds(halfNode);
+            split(halfNode);
+        }
+    }
+
+    void cullNode(const FrustumCuller &frustum, int index, unsigned int planeMask, vector<unsigned int> &visible, unsigned int &tested) const
+    {
+        const Node &node = nodes[index];
+        if (node.bounds.empty())
+            return;
+        // a parent fully inside the frustum accepts its subtree without further tests
+        if (planeMask) {
+            tested++;
+            if (frustum.classify(node.bounds, planeMask) == FrustumCuller::OUTSIDE)
+                return;
+        }
+        if (node.object >= 0) {
+            visible.push_back((unsigned int) node.object);
+            return;
+        }
+        for (int child : node.children)
+            cullNode(frustum, child, planeMask, visible, tested);
+    }
+
+    template<typename Test>
+    void queryNode(int index, vector<unsigned int> &found, const Test &test) const
+    {
+        const Node &node = nodes[index];
+        if (node.bounds.empty() || !test(node.bounds))
+            return;
+        if (node.object >= 0) {
+            found.push_back((unsigned int) node.object);
+            return;
+        }
+        for (int child : node.children)
+            queryNode(child, found, test);
+    }
+
+    void raycastNode(int index, glm::vec3 origin, glm::vec3 inverse, float &nearest, unsigned int &object, bool &hit) const
+    {
+        const Node &node = nodes[index];
+        float enter;
+        if (node.bounds.empty() || !node.bounds.intersectRay(origin, inverse, nearest, enter))
+            return;
+        if (node.object >= 0) {
+            nearest = enter;
+            object = (unsigned int) node.object;
+            hit = true;
+            return;
+        }
+        // nearer children first, so the farther ones are mostly rejected by the shrunk distance
+        vector<pair<float, int>> order;
+        for (int child : node.children) {
+            float childEnter;
+            if (nodes[child].bounds.intersectRay(origin, inverse, nearest, childEnter))
+                order.push_back(make_pair(childEnter, child));
+        }
+        std::sort(order.begin(), order.end());
+        for (const pair<float, int> &child : order)
+            if (child.first <= nearest)
+                raycastNode(child.second, origin, inverse, nearest, object, hit);
+    }
+};
+#endif
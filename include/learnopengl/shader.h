@@ -4,18 +4,46 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstdint>
+#include <unordered_map>
 #include <common.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/uniform_buffer.h>
+
+// FNV-1a over a uniform name, constexpr so names written as literals can be hashed by the compiler
+constexpr uint32_t hashUniformName(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    while (*name)
+        hash = (hash ^ (uint8_t) *name++) * 16777619u;
+    return hash;
+}
+
+// Name of a uniform, reduced to its hash. Literals convert implicitly, so shader.setVec3("viewPosition", ...)
+// keeps working but no longer allocates a string or asks the driver for the location; for names in hot code
+// a constexpr UniformId makes sure the hash is computed at compile time:
+//     constexpr UniformId VIEW_POSITION("viewPosition");
+struct UniformId {
+    uint32_t hash;
+
+    constexpr UniformId(const char *name) : hash(hashUniformName(name)) {}
+    UniformId(const std::string &name) : hash(hashUniformName(name.c_str())) {}
+};
+
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly. defines ("#define NAME [value]" lines, see
+    // shader_variants.h) go in right after each stage's #version line, and #include "file" lines
+    // are replaced by the file, relative to the one including it.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::string &defines = "")
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
@@ -46,8 +74,8 @@ public:
             vShaderFile.close();
             fShaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            vertexCode = preprocess(vShaderStream.str(), vertexPath, defines);
+            fragmentCode = preprocess(fShaderStream.str(), fragmentPath, defines);
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
@@ -57,7 +85,7 @@ public:
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                geometryCode = preprocess(gShaderStream.str(), geometryPath, defines);
             }
         }
         catch (std::ifstream::failure& e)
@@ -96,6 +124,8 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        cacheUniformLocations();
+        bindUniformBlocks();
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -107,68 +137,188 @@ public:
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        glState().useProgram(ID); 
+    }
+    // location of an active uniform, -1 (which glUniform* ignores) if the program doesn't use it
+    // ------------------------------------------------------------------------
+    GLint location(UniformId name) const
+    {
+        std::unordered_map<uint32_t, GLint>::const_iterator found = locations.find(name.hash);
+        return found != locations.end() ? found->second : -1;
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(UniformId name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(UniformId name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(location(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(UniformId name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(location(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(UniformId name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(location(name), 1, &value[0]); 
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(UniformId name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(location(name), x, y); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(UniformId name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(location(name), 1, &value[0]); 
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(UniformId name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(location(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(UniformId name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(location(name), 1, &value[0]); 
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(UniformId name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(location(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(UniformId name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(UniformId name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(UniformId name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // active uniform locations by name hash, filled once after linking
+    std::unordered_map<uint32_t, GLint> locations;
+
+    // introspects every active uniform, so the setters never have to ask the driver.
+    // arrays of basic types are reported as "name[0]", every element is added along with the bare name.
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint) i, (GLsizei) name.size(), &length, &size, &type, &name[0]);
+            std::string uniform = name.substr(0, length);
+            GLint first = glGetUniformLocation(ID, uniform.c_str());
+            if (first < 0)
+                continue; // uniforms inside a uniform block have no location
+            addLocation(uniform, first);
+            size_t bracket = uniform.rfind("[0]");
+            if (bracket != std::string::npos && bracket + 3 == uniform.size())
+            {
+                std::string base = uniform.substr(0, bracket);
+                addLocation(base, first);
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    addLocation(elementName, glGetUniformLocation(ID, elementName.c_str()));
+                }
+            }
+        }
+    }
+
+    // points every shared uniform block the program declares at its fixed binding, see uniform_buffer.h
+    // ------------------------------------------------------------------------
+    void bindUniformBlocks()
+    {
+        for (unsigned int binding = 0; binding < UNIFORM_BLOCK_COUNT; binding++)
+        {
+            GLuint index = glGetUniformBlockIndex(ID, UNIFORM_BLOCK_NAMES[binding]);
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(ID, index, binding);
+        }
+    }
+
+    // resolves #include "file" and adds the defines after #version. #line directives keep the
+    // compiler's line numbers pointing into the right file, included files count from source 1 on.
+    // ------------------------------------------------------------------------
+    static std::string preprocess(const std::string &source, const std::string &path, const std::string &defines)
+    {
+        int nextSource = 1;
+        std::string code = resolveIncludes(source, path, 0, 0, nextSource);
+        size_t version = code.find("#version");
+        if (version == std::string::npos || defines.empty())
+            return code;
+        size_t lineEnd = code.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return code + "\n" + defines;
+        // the defines don't shift the lines after them
+        int versionLine = 1 + (int) std::count(code.begin(), code.begin() + lineEnd, '\n');
+        return code.substr(0, lineEnd + 1) + defines + "#line " + std::to_string(versionLine + 1) + " 0\n" + code.substr(lineEnd + 1);
+    }
+
+    static std::string resolveIncludes(const std::string &source, const std::string &path, int depth, int sourceNumber, int &nextSource)
+    {
+        if (depth > 8) {
+            std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP: " << path << std::endl;
+            return "";
+        }
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        std::istringstream lines(source);
+        std::string line, result;
+        int lineNumber = 0;
+        while (std::getline(lines, line))
+        {
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+                result += line + "\n";
+                continue;
+            }
+            size_t open = line.find('"', start), close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos) {
+                std::cout << "ERROR::SHADER::BAD_INCLUDE: " << path << ":" << lineNumber << std::endl;
+                continue;
+            }
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            std::ifstream file(includePath);
+            if (!file) {
+                std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath << std::endl;
+                continue;
+            }
+            std::stringstream included;
+            included << file.rdbuf();
+            int includedSource = nextSource++;
+            result += "#line 1 " + std::to_string(includedSource) + "\n";
+            result += resolveIncludes(included.str(), includePath, depth + 1, includedSource, nextSource);
+            result += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(sourceNumber) + "\n";
+        }
+        return result;
+    }
+
+    void addLocation(const std::string &name, GLint value)
+    {
+        std::pair<std::unordered_map<uint32_t, GLint>::iterator, bool> inserted = locations.insert(std::make_pair(hashUniformName(name.c_str()), value));
+        if (!inserted.second && inserted.first->second != value)
+            std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION: " << name << std::endl;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
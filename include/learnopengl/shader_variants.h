@@ -0,0 +1,88 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <learnopengl/shader.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+using namespace std;
+
+// compile time features of the shaders, each one a #define in the variant that has it. A shader
+// only looks at the ones it was written for, see ShaderVariants.
+enum ShaderFeature : uint32_t {
+    FEATURE_NO_SPECULAR   = 1 << 0,     // NO_SPECULAR: the material has no specular map, no specular term
+    FEATURE_HAS_NORMALMAP = 1 << 1,     // HAS_NORMALMAP: perturbs the normal with texture_normal1
+    FEATURE_IMPOSTOR_FADE = 1 << 2,     // IMPOSTOR_FADE: dithers out into the impostor (see impostor.h)
+    FEATURE_HDR_OFF       = 1 << 3,     // HDR_OFF: no tone mapping in hdr.fs
+    FEATURE_BLOOM_OFF     = 1 << 4,     // BLOOM_OFF: no bloom added in hdr.fs
+    FEATURE_BLOOM_PREFILTER = 1 << 5,   // BLOOM_PREFILTER: bright pass in the first bloom_down.fs step (see bloom.h)
+    SHADER_FEATURE_COUNT  = 6
+};
+
+// the #define of every feature bit, in bit order
+static const char *const SHADER_FEATURE_NAMES[SHADER_FEATURE_COUNT] = {
+    "NO_SPECULAR", "HAS_NORMALMAP", "IMPOSTOR_FADE", "HDR_OFF", "BLOOM_OFF", "BLOOM_PREFILTER"
+};
+
+// the #define lines of a feature set
+inline string shaderDefines(uint32_t features)
+{
+    string defines;
+    for (unsigned int bit = 0; bit < SHADER_FEATURE_COUNT; bit++)
+        if (features & (1u << bit))
+            defines += string("#define ") + SHADER_FEATURE_NAMES[bit] + "\n";
+    return defines;
+}
+
+// One shader source compiled into a program per feature set.
+//
+// get() hands out the program for a feature bitmask, compiling it the first time that set is asked
+// for. Bits the source doesn't use (outside of supported) are dropped first, so callers can pass
+// everything they know about a draw and still share one program where it makes no difference.
+// defines is put in front of every variant, for valued defines that are the same for all of them.
+// setup runs once on every new program, for the uniforms that never change (sampler units and the like).
+//
+// The programs are compiled on the GL thread at first use; a variant first needed mid-frame
+// costs that frame its compile.
+class ShaderVariants
+{
+public:
+    ShaderVariants(const char *vertexPath, const char *fragmentPath, uint32_t supported,
+                   function<void(Shader &)> setup = nullptr, const string &defines = "")
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), supported(supported), setup(std::move(setup)), defines(defines)
+    {
+    }
+
+    ShaderVariants(const ShaderVariants &) = delete;
+    ShaderVariants &operator=(const ShaderVariants &) = delete;
+
+    Shader &get(uint32_t features)
+    {
+        features &= supported;
+        unordered_map<uint32_t, unique_ptr<Shader>>::iterator found = variants.find(features);
+        if (found != variants.end())
+            return *found->second;
+        unique_ptr<Shader> shader(new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, defines + shaderDefines(features)));
+        if (setup)
+            setup(*shader);
+        Shader &compiled = *shader;
+        variants[features] = std::move(shader);
+        return compiled;
+    }
+
+    // the feature bits this source reacts to
+    uint32_t features() const { return supported; }
+
+    unsigned int compiledCount() const { return (unsigned int) variants.size(); }
+
+private:
+    string vertexPath, fragmentPath;
+    uint32_t supported;
+    function<void(Shader &)> setup;
+    string defines;
+    unordered_map<uint32_t, unique_ptr<Shader>> variants;
+};
+#endif
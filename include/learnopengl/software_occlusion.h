@@ -0,0 +1,324 @@
+#ifndef SOFTWARE_OCCLUSION_H
+#define SOFTWARE_OCCLUSION_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SOFTWARE_OCCLUSION_SSE 1
+#endif
+using namespace std;
+
+// appends the triangles of an indexed mesh as a plain list of object space positions, three per triangle
+inline void appendTriangles(vector<glm::vec3> &triangles, const void *vertices, const VertexEncoding &encoding,
+                            const void *indices, GLenum indexType, size_t indexCount)
+{
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+        for (size_t k = 0; k < 3; k++) {
+            size_t index = indexType == GL_UNSIGNED_SHORT ? ((const unsigned short *) indices)[i + k] : ((const unsigned int *) indices)[i + k];
+            triangles.push_back(vertexPosition(vertices, index, encoding));
+        }
+}
+
+// keeps the budget largest triangles. They are a subset of the surface, so the reduced mesh never
+// hides more than the full one would, and the biggest faces do most of the hiding anyway.
+inline void keepLargestTriangles(vector<glm::vec3> &triangles, size_t budget)
+{
+    size_t count = triangles.size() / 3;
+    if (count <= budget)
+        return;
+    vector<pair<float, unsigned int>> areas(count);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 normal = glm::cross(triangles[3 * i + 1] - triangles[3 * i], triangles[3 * i + 2] - triangles[3 * i]);
+        areas[i] = make_pair(-glm::dot(normal, normal), (unsigned int) i);
+    }
+    std::nth_element(areas.begin(), areas.begin() + budget, areas.end());
+    vector<glm::vec3> largest;
+    largest.reserve(budget * 3);
+    for (size_t i = 0; i < budget; i++)
+        for (size_t k = 0; k < 3; k++)
+            largest.push_back(triangles[3 * areas[i].second + k]);
+    triangles.swap(largest);
+}
+
+// Occlusion culling on the CPU: a few low poly occluders are rasterized into a small depth buffer,
+// then boxes are tested against a max depth pyramid (hierarchical Z) built from it. Everything
+// happens before the frame's draws are queued, so the results are ready the same frame and
+// nothing is read back from the GPU.
+//
+// Coverage is sampled at pixel centers, so neighbouring triangles leave no cracks, but a covered pixel
+// takes the farthest depth its triangle has over the whole pixel. Box tests read one pixel more on
+// every side, which makes up for the half pixel a sampled edge can be off. Rows are split into bands
+// rasterized in parallel on the worker pool, four pixels per SSE iteration.
+//
+// Per frame: begin() with projection * view, addOccluder() the occluders, render(), then occluded().
+class SoftwareOcclusion
+{
+public:
+    struct Stats {
+        unsigned int triangles;     // occluder triangles rasterized
+        unsigned int tested;
+        unsigned int occluded;
+    };
+
+    // width has to be a multiple of 4
+    SoftwareOcclusion(unsigned int width = 256, unsigned int height = 128) : width(width), height(height)
+    {
+        for (unsigned int w = width, h = height; ; w = (w + 1) / 2, h = (h + 1) / 2) {
+            levels.push_back(Level());
+            levels.back().width = w;
+            levels.back().height = h;
+            levels.back().depth.assign(w * h, 1.0f);
+            if (w == 1 && h == 1)
+                break;
+        }
+        frameStats.triangles = frameStats.tested = frameStats.occluded = 0;
+    }
+
+    void begin(const glm::mat4 &viewProjection)
+    {
+        this->viewProjection = viewProjection;
+        occluders.clear();
+        frameStats.triangles = frameStats.tested = frameStats.occluded = 0;
+    }
+
+    // triangles (three object space positions each) placed with transform, kept by pointer until render()
+    void addOccluder(const vector<glm::vec3> &triangles, const glm::mat4 &transform)
+    {
+        if (!triangles.empty())
+            occluders.push_back(Occluder{&triangles, viewProjection * transform});
+    }
+
+    // rasterizes the occluders and builds the depth pyramid
+    void render()
+    {
+        setup.clear();
+        for (const Occluder &occluder : occluders)
+            for (size_t i = 0; i + 2 < occluder.triangles->size(); i += 3)
+                setupTriangle(occluder.clip * glm::vec4((*occluder.triangles)[i], 1.0f),
+                              occluder.clip * glm::vec4((*occluder.triangles)[i + 1], 1.0f),
+                              occluder.clip * glm::vec4((*occluder.triangles)[i + 2], 1.0f));
+        frameStats.triangles = (unsigned int) setup.size();
+
+        // bands of at least 8 rows. parallelFor runs the ones the pool doesn't get to on this thread,
+        // so the culling never waits behind texture decodes
+        parallelFor(height, 8, [this](unsigned int, size_t begin, size_t end) {
+            rasterizeBand((unsigned int) begin, (unsigned int) end);
+        });
+
+        for (size_t level = 1; level < levels.size(); level++)
+            downsample(levels[level - 1], levels[level]);
+    }
+
+    // true if the world space box is certainly behind the occluders. Boxes crossing the near plane or
+    // off screen are never occluded, the frustum test is the one to reject the latter.
+    bool occluded(const Aabb &box)
+    {
+        bool hidden = test(box);
+        count(1, hidden ? 1 : 0);
+        return hidden;
+    }
+
+    // occluded() without the counting, safe to call from several threads after render()
+    bool test(const Aabb &box) const
+    {
+        if (box.empty())
+            return false;
+        glm::vec2 minimum(FLT_MAX), maximum(-FLT_MAX);
+        float nearest = FLT_MAX;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec4 clip = viewProjection * glm::vec4(corner & 1 ? box.maximum.x : box.minimum.x,
+                                                        corner & 2 ? box.maximum.y : box.minimum.y,
+                                                        corner & 4 ? box.maximum.z : box.minimum.z, 1.0f);
+            if (clip.w <= 1e-5f || clip.z < -clip.w)
+                return false;
+            glm::vec2 screen = (glm::vec2(clip.x, clip.y) / clip.w * 0.5f + 0.5f) * glm::vec2((float) width, (float) height);
+            minimum = glm::min(minimum, screen);
+            maximum = glm::max(maximum, screen);
+            nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+        }
+        if (maximum.x < 0.0f || maximum.y < 0.0f || minimum.x >= width || minimum.y >= height)
+            return false;
+        int x0 = std::max(0, (int) std::floor(minimum.x) - 1), x1 = std::min((int) width - 1, (int) std::floor(maximum.x) + 1);
+        int y0 = std::max(0, (int) std::floor(minimum.y) - 1), y1 = std::min((int) height - 1, (int) std::floor(maximum.y) + 1);
+
+        // the finest level where the rectangle spans at most 2x2 texels
+        unsigned int level = 0;
+        while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+            level++;
+        const Level &hiZ = levels[level];
+        float farthest = 0.0f;
+        for (int y = y0 >> level; y <= y1 >> level; y++)
+            for (int x = x0 >> level; x <= x1 >> level; x++)
+                farthest = std::max(farthest, hiZ.depth[y * hiZ.width + x]);
+        return nearest > farthest;
+    }
+
+    // adds tests done through test() to stats()
+    void count(unsigned int tested, unsigned int occluded)
+    {
+        frameStats.tested += tested;
+        frameStats.occluded += occluded;
+    }
+
+    const Stats &stats() const { return frameStats; }
+
+private:
+    struct Occluder {
+        const vector<glm::vec3> *triangles;
+        glm::mat4 clip;             // object to clip space
+    };
+
+    // edge functions and depth plane of a screen space triangle, both evaluated at pixel centers.
+    // the depth is pushed back by half a pixel's worth of slope, the farthest it gets over the pixel.
+    struct Triangle {
+        float edgeX[3], edgeY[3], edgeC[3];
+        float depthX, depthY, depthC;
+        int minX, maxX, minY, maxY;
+    };
+
+    struct Level {
+        unsigned int width, height;
+        vector<float> depth;        // [0, 1] window depth, the max over the texels of the level below
+    };
+
+    unsigned int width, height;
+    glm::mat4 viewProjection;
+    vector<Occluder> occluders;
+    vector<Triangle> setup;
+    vector<Level> levels;
+    Stats frameStats;
+
+    // clips a clip space triangle against the near plane and sets up what is left
+    void setupTriangle(glm::vec4 a, glm::vec4 b, glm::vec4 c)
+    {
+        // all three outside the same side of the frustum, nothing to draw
+        for (int axis = 0; axis < 3; axis++) {
+            if (a[axis] > a.w && b[axis] > b.w && c[axis] > c.w)
+                return;
+            if (a[axis] < -a.w && b[axis] < -b.w && c[axis] < -c.w)
+                return;
+        }
+        glm::vec4 input[3] = {a, b, c};
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++) {
+            const glm::vec4 &from = input[i], &to = input[(i + 1) % 3];
+            float dFrom = from.z + from.w, dTo = to.z + to.w;
+            if (dFrom >= 0.0f)
+                polygon[count++] = from;
+            if ((dFrom >= 0.0f) != (dTo >= 0.0f))
+                polygon[count++] = from + (to - from) * (dFrom / (dFrom - dTo));
+        }
+        for (int i = 1; i + 1 < count; i++)
+            setupScreenTriangle(project(polygon[0]), project(polygon[i]), project(polygon[i + 1]));
+    }
+
+    glm::vec3 project(const glm::vec4 &clip) const
+    {
+        float w = std::max(clip.w, 1e-6f);
+        return glm::vec3((clip.x / w * 0.5f + 0.5f) * width, (clip.y / w * 0.5f + 0.5f) * height, clip.z / w * 0.5f + 0.5f);
+    }
+
+    void setupScreenTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+    {
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::fabs(area) < 1e-6f)
+            return;
+        // occluders are drawn from both sides, the edges are oriented so the inside is positive
+        if (area < 0.0f) {
+            std::swap(b, c);
+            area = -area;
+        }
+        Triangle triangle;
+        const glm::vec3 vertices[3] = {a, b, c};
+        for (int i = 0; i < 3; i++) {
+            const glm::vec3 &from = vertices[i], &to = vertices[(i + 1) % 3];
+            triangle.edgeX[i] = from.y - to.y;
+            triangle.edgeY[i] = to.x - from.x;
+            triangle.edgeC[i] = from.x * to.y - from.y * to.x;
+        }
+        // depth = depthX * x + depthY * y + depthC, from the plane through the three vertices
+        triangle.depthX = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+        triangle.depthY = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+        triangle.depthC = a.z - triangle.depthX * a.x - triangle.depthY * a.y + 0.5f * (std::fabs(triangle.depthX) + std::fabs(triangle.depthY));
+
+        triangle.minX = std::max(0, (int) std::floor(std::min(a.x, std::min(b.x, c.x)))) & ~3;
+        triangle.maxX = std::min((int) width - 1, (int) std::floor(std::max(a.x, std::max(b.x, c.x))));
+        triangle.minY = std::max(0, (int) std::floor(std::min(a.y, std::min(b.y, c.y))));
+        triangle.maxY = std::min((int) height - 1, (int) std::floor(std::max(a.y, std::max(b.y, c.y))));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return;
+        setup.push_back(triangle);
+    }
+
+    // clears rows [first, last) of the full resolution level and draws every triangle into them
+    void rasterizeBand(unsigned int first, unsigned int last)
+    {
+        float *depth = levels[0].depth.data();
+        std::fill(depth + first * width, depth + last * width, 1.0f);
+        for (const Triangle &triangle : setup)
+        {
+            int minY = std::max(triangle.minY, (int) first), maxY = std::min(triangle.maxY, (int) last - 1);
+            for (int y = minY; y <= maxY; y++)
+            {
+                float centerY = y + 0.5f;
+                float *row = depth + y * width;
+#ifdef SOFTWARE_OCCLUSION_SSE
+                const __m128 zero = _mm_setzero_ps();
+                __m128 rowEdge[3], edgeX[3];
+                for (int i = 0; i < 3; i++) {
+                    rowEdge[i] = _mm_set1_ps(triangle.edgeY[i] * centerY + triangle.edgeC[i]);
+                    edgeX[i] = _mm_set1_ps(triangle.edgeX[i]);
+                }
+                __m128 rowDepth = _mm_set1_ps(triangle.depthY * centerY + triangle.depthC);
+                __m128 depthX = _mm_set1_ps(triangle.depthX);
+                for (int x = triangle.minX; x <= triangle.maxX; x += 4) {
+                    __m128 centerX = _mm_add_ps(_mm_set1_ps((float) x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                    __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[0], centerX), rowEdge[0]), zero);
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[1], centerX), rowEdge[1]), zero));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[2], centerX), rowEdge[2]), zero));
+                    if (!_mm_movemask_ps(inside))
+                        continue;
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(old, _mm_add_ps(_mm_mul_ps(depthX, centerX), rowDepth));
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+                }
+#else
+                for (int x = triangle.minX; x <= triangle.maxX; x++) {
+                    float centerX = x + 0.5f;
+                    bool inside = true;
+                    for (int i = 0; i < 3 && inside; i++)
+                        inside = triangle.edgeX[i] * centerX + triangle.edgeY[i] * centerY + triangle.edgeC[i] >= 0.0f;
+                    if (inside)
+                        row[x] = std::min(row[x], triangle.depthX * centerX + triangle.depthY * centerY + triangle.depthC);
+                }
+#endif
+            }
+        }
+    }
+
+    static void downsample(const Level &source, Level &target)
+    {
+        for (unsigned int y = 0; y < target.height; y++)
+            for (unsigned int x = 0; x < target.width; x++) {
+                unsigned int x0 = 2 * x, x1 = std::min(2 * x + 1, source.width - 1);
+                unsigned int y0 = 2 * y, y1 = std::min(2 * y + 1, source.height - 1);
+                target.depth[y * target.width + x] = std::max(std::max(source.depth[y0 * source.width + x0], source.depth[y0 * source.width + x1]),
+                                                              std::max(source.depth[y1 * source.width + x0], source.depth[y1 * source.width + x1]));
+            }
+    }
+};
+#endif
@@ -0,0 +1,174 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+using namespace std;
+
+// glBufferStorage and its flags are GL 4.4, past the glad build in libs/, see indirect_draw.h
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRYP PFNBUFFERSTORAGE)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+// glBufferStorage once loadBufferStorage found it, null before and on contexts older than 4.4
+inline PFNBUFFERSTORAGE &bufferStorage()
+{
+    static PFNBUFFERSTORAGE entry = nullptr;
+    return entry;
+}
+
+inline bool loadBufferStorage(GLADloadproc loader)
+{
+    if (GLVersion.major * 10 + GLVersion.minor < 44)
+        return false;
+    bufferStorage() = (PFNBUFFERSTORAGE) loader("glBufferStorage");
+    return bufferStorage() != nullptr;
+}
+
+// Ring of per-frame regions in one buffer for data written once per frame: instance matrices,
+// indirect commands and the like.
+//
+// Every frame writes into its own region, linearly, and draws reference the data by offset into
+// buffer(). After the frame's draws a fence goes in behind them; a region is only written again
+// once its fence signalled, which with regionCount regions is regionCount - 1 frames later and
+// normally never waits. So the driver neither copies the data nor synchronizes on the buffer.
+//
+// With glBufferStorage the buffer is mapped once, persistently and coherently. Without it (GL 3.3)
+// the frame's region is mapped unsynchronized in beginFrame and unmapped in flush, the fences
+// make the unsynchronized write safe in the same way.
+//
+// Per frame: beginFrame(), allocate() as needed, flush() before the first draw that reads the
+// data, endFrame() after the last one. The destructor deletes the fences and unmaps the buffer, so the
+// owner has to go while the context is still current.
+class StreamBuffer
+{
+public:
+    struct Allocation {
+        void *data;         // where to write, null if the region is full or not mapped
+        size_t offset;      // byte offset of data in buffer()
+    };
+
+    StreamBuffer(size_t regionSize = 4 << 20, unsigned int regionCount = 3)
+        : regionSize(regionSize), regionCount(regionCount), region(0), used(0), mapped(nullptr), persistentMapping(nullptr), waits(0)
+    {
+        for (unsigned int i = 0; i < MAX_REGIONS; i++)
+            fences[i] = 0;
+        if (this->regionCount > MAX_REGIONS)
+            this->regionCount = MAX_REGIONS;
+
+        size_t size = this->regionSize * this->regionCount;
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        if (bufferStorage()) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage()(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+            persistentMapping = (char *) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+            if (!persistentMapping)
+                cout << "ERROR::STREAM_BUFFER:: Persistent mapping failed" << endl;
+        } else {
+            glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    ~StreamBuffer()
+    {
+        for (unsigned int i = 0; i < regionCount; i++)
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        if (persistentMapping || mapped) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+        glDeleteBuffers(1, &ID);
+    }
+
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    unsigned int buffer() const { return ID; }
+    bool persistent() const { return persistentMapping != nullptr; }
+
+    // frames that had to wait for the GPU to release their region, since startup
+    unsigned int stalls() const { return waits; }
+
+    // moves on to the next region, waiting until the GPU is done with what it held
+    void beginFrame()
+    {
+        region = (region + 1) % regionCount;
+        used = 0;
+        if (fences[region]) {
+            if (glClientWaitSync(fences[region], 0, 0) == GL_TIMEOUT_EXPIRED) {
+                waits++;
+                while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+                    ;
+            }
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+        if (persistentMapping) {
+            mapped = persistentMapping + region * regionSize;
+        } else {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            mapped = (char *) glMapBufferRange(GL_COPY_WRITE_BUFFER, region * regionSize, regionSize,
+                                               GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+    }
+
+    // bytes from the current region, alignment has to be a power of two that divides regionSize
+    Allocation allocate(size_t bytes, size_t alignment = 16)
+    {
+        Allocation allocation;
+        size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (!mapped || start + bytes > regionSize) {
+            allocation.data = nullptr;
+            allocation.offset = 0;
+            return allocation;
+        }
+        used = start + bytes;
+        allocation.data = mapped + start;
+        allocation.offset = region * regionSize + start;
+        return allocation;
+    }
+
+    // makes the frame's writes visible to the draws, no allocations after this
+    void flush()
+    {
+        if (!persistentMapping && mapped) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        mapped = nullptr;
+    }
+
+    // fences the region behind the frame's draws
+    void endFrame()
+    {
+        flush();
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+private:
+    static const unsigned int MAX_REGIONS = 4;
+
+    unsigned int ID;
+    size_t regionSize;
+    unsigned int regionCount;
+    unsigned int region;
+    size_t used;
+    char *mapped;               // the current region while it can be written
+    char *persistentMapping;    // the whole buffer, null without glBufferStorage
+    GLsync fences[MAX_REGIONS];
+    unsigned int waits;
+};
+#endif
@@ -0,0 +1,493 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/image.h>
+#include <learnopengl/thread_pool.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Process-wide texture registry that streams textures in without ever blocking the render thread.
+//
+// load() hands out a handle right away and queues the decode on the worker pool. Until the pixels
+// arrive the handle resolves to a shared 1x1 placeholder. update(), called once per frame, maps a
+// pixel buffer object for every finished decode and lets a worker copy the pixels into it. Once the
+// copy is done the GL thread unmaps it and sources glTexImage2D from the PBO, which makes the transfer
+// asynchronous on the driver side, and the handle is switched over to the real texture.
+// Handles are indices into a table, so switching is a single store and never invalidates a handle
+// held by a mesh. Bind with glState().bindTexture(unit, GL_TEXTURE_2D, textureLoader().name(handle)).
+//
+// Every texture is resident exactly once. Requests are looked up by normalized path, and the worker
+// hashes the file contents before decoding, so a byte-identical copy under another name is never
+// decoded; its handle becomes an alias of the first one. Handles are reference counted by load()
+// and release().
+class TextureLoader
+{
+public:
+    // handle that always resolves to the placeholder
+    static const unsigned int PLACEHOLDER = 0;
+    // bytes of pixel data per frame, once for starting copies and once for the glTexImage2D and mipmap
+    // generation that finish them, keeps a burst of finished decodes from hitching a frame. A frame
+    // always gets one texture through even if it is larger, the rest waits for the next frames.
+    static const size_t UPLOAD_BUDGET = 16 * 1024 * 1024;
+
+    TextureLoader() : placeholder(0), placeholderCube(0)
+    {
+        entries.push_back(Entry());
+        entries[PLACEHOLDER].state = READY;
+        entries[PLACEHOLDER].refs = 1;
+    }
+
+    // starts decoding an image before anyone asks for it, callable from any thread.
+    // a later load() of the same path picks up the decode instead of starting a new one.
+    void prefetch(const string &path, bool flip = false, bool clampTransparent = false)
+    {
+        string key = makeKey(path, flip, clampTransparent);
+        lock_guard<mutex> lock(registryMutex);
+        if (prefetched.count(key) || byPath.count(key))
+            return;
+        Entry entry;
+        entry.key = key;
+        entry.path = path;
+        entry.clampTransparent = clampTransparent;
+        entry.decoding = submitDecode(key, path, flip, clampTransparent);
+        prefetched[key] = std::move(entry);
+    }
+
+    // returns a handle for the texture at path immediately, taking a reference on it. Main thread only,
+    // but it doesn't need a GL context: textures can be requested before the window exists.
+    // clampTransparent clamps images with an alpha channel to the edge instead of repeating them.
+    unsigned int load(const string &path, bool flip = false, bool clampTransparent = false)
+    {
+        string key = makeKey(path, flip, clampTransparent);
+        lock_guard<mutex> lock(registryMutex);
+        unordered_map<string, unsigned int>::iterator found = byPath.find(key);
+        if (found != byPath.end()) {
+            entries[found->second].refs++;
+            return found->second;
+        }
+
+        unordered_map<string, Entry>::iterator pending = prefetched.find(key);
+        if (pending != prefetched.end()) {
+            Entry entry = std::move(pending->second);
+            prefetched.erase(pending);
+            return addEntry(std::move(entry));
+        }
+        Entry entry;
+        entry.key = key;
+        entry.path = path;
+        entry.clampTransparent = clampTransparent;
+        entry.decoding = submitDecode(key, path, flip, clampTransparent);
+        return addEntry(std::move(entry));
+    }
+
+    // cube map counterpart of load(), the faces in +X, -X, +Y, -Y, +Z, -Z order.
+    // bind with glState().bindTexture(unit, GL_TEXTURE_CUBE_MAP, textureLoader().name(handle)).
+    unsigned int loadCubemap(const vector<string> &faces, bool flip = false)
+    {
+        string key = "cube";
+        for (const string &face : faces)
+            key += ":" + makeKey(face, flip, false);
+        lock_guard<mutex> lock(registryMutex);
+        unordered_map<string, unsigned int>::iterator found = byPath.find(key);
+        if (found != byPath.end()) {
+            entries[found->second].refs++;
+            return found->second;
+        }
+
+        Entry entry;
+        entry.key = key;
+        entry.path = faces.empty() ? string() : faces[0];
+        entry.target = GL_TEXTURE_CUBE_MAP;
+        // the faces belong to one texture object, so they skip the content deduplication
+        for (const string &face : faces)
+            entry.faces.push_back(workerPool().submit([face, flip] { return loadImage(face, flip); }));
+        return addEntry(std::move(entry));
+    }
+
+    // drops a reference, the GL texture is deleted once nothing holds it anymore.
+    void release(unsigned int handle)
+    {
+        lock_guard<mutex> lock(registryMutex);
+        releaseLocked(handle);
+    }
+
+    // GL name to bind for a handle: the real texture once it's resident, the placeholder until then.
+    unsigned int name(unsigned int handle) const
+    {
+        const Entry &entry = entries[entries[handle].canonical];
+        if (entry.name)
+            return entry.name;
+        return entry.target == GL_TEXTURE_CUBE_MAP ? placeholderCube : placeholder;
+    }
+
+    bool isReady(unsigned int handle) const
+    {
+        return entries[entries[handle].canonical].state == READY;
+    }
+
+    unsigned int pendingCount() const
+    {
+        return (unsigned int) inFlight.size();
+    }
+
+    // number of distinct textures that made it to the GPU
+    unsigned int residentCount() const
+    {
+        unsigned int count = 0;
+        for (const Entry &entry : entries)
+            count += entry.name != 0 && entry.state == READY;
+        return count;
+    }
+
+    // advances in-flight textures, call once per frame on the GL thread.
+    void update()
+    {
+        createPlaceholders();
+        lock_guard<mutex> lock(registryMutex);
+        size_t budget = UPLOAD_BUDGET, finishBudget = UPLOAD_BUDGET;
+        for (size_t k = 0; k < inFlight.size();) {
+            unsigned int handle = inFlight[k];
+            Entry &entry = entries[handle];
+            bool done = false;
+            if (entry.target == GL_TEXTURE_CUBE_MAP) {
+                done = entry.state == DECODING && allDone(entry.faces) && uploadCubemap(entry);
+            } else if (entry.state == DECODING && budget > 0 && isDone(entry.decoding)) {
+                Decoded decoded = entry.decoding.get();
+                entry.contentHash = decoded.contentHash;
+                if (decoded.duplicate) {
+                    entry.state = ALIAS_PENDING;
+                } else if (!decoded.image.data) {
+                    std::cout << "Texture failed to load at path: " << entry.path << std::endl;
+                    entry.state = FAILED;
+                    byContent[entry.contentHash] = handle;
+                    done = true;
+                } else {
+                    byContent[entry.contentHash] = handle;
+                    entry.image = std::move(decoded.image);
+                    size_t size = (size_t) entry.image.width * entry.image.height * entry.image.components;
+                    budget -= std::min(size, budget);
+                    startCopy(entry, size);
+                }
+            }
+            if (entry.state == COPYING && finishBudget > 0 && isDone(entry.copying)) {
+                entry.copying.get();
+                size_t size = (size_t) entry.image.width * entry.image.height * entry.image.components;
+                finishBudget -= std::min(size, finishBudget);
+                finishUpload(entry);
+                done = true;
+            }
+            // last, resolveAlias can grow the table and leave the reference above dangling
+            if (entry.state == ALIAS_PENDING)
+                done = resolveAlias(handle);
+            if (done && entries[handle].refs == 0 && entries[handle].canonical == handle)
+                drop(handle); // released while it was still on its way
+            if (done)
+                inFlight.erase(inFlight.begin() + k);
+            else
+                k++;
+        }
+    }
+
+private:
+    enum State { DECODING, COPYING, ALIAS_PENDING, READY, FAILED, RELEASED };
+
+    // worker output: the pixels, or just the content hash if another request already owns those bytes
+    struct Decoded {
+        Image image;
+        uint64_t contentHash;
+        bool duplicate;
+
+        Decoded() : contentHash(0), duplicate(false) {}
+    };
+
+    struct Entry {
+        string key;
+        string path;
+        GLenum target;
+        bool clampTransparent;
+        unsigned int refs;
+        unsigned int canonical; // handle that owns the GL texture, itself unless this is an alias
+        unsigned int name;
+        State state;
+        uint64_t contentHash;
+        future<Decoded> decoding;
+        vector<future<Image>> faces;
+        Image image;
+        unsigned int pbo;
+        bool mapped;
+        future<void> copying;
+
+        Entry() : target(GL_TEXTURE_2D), clampTransparent(false), refs(0), canonical(0), name(0),
+                  state(DECODING), contentHash(0), pbo(0), mapped(false) {}
+    };
+
+    vector<Entry> entries;
+    vector<unsigned int> inFlight;    // handles still decoding or copying, in request order
+    vector<unsigned int> freeBuffers; // pixel buffer objects ready for reuse
+    unsigned int placeholder;
+    unsigned int placeholderCube;
+
+    unordered_map<string, unsigned int> byPath;       // normalized path and load flags -> handle
+    unordered_map<uint64_t, unsigned int> byContent;  // content hash -> handle owning the GL texture
+    unordered_map<string, Entry> prefetched;          // decodes started by prefetch(), not in the table yet
+    mutex registryMutex;
+
+    // content hash -> key of the decode that claimed it, shared with the workers so duplicates are never decoded
+    unordered_map<uint64_t, string> claimedContent;
+    mutex claimMutex;
+
+    // points a duplicate at the handle owning its bytes, returns whether it's settled. The owner may
+    // still be decoding, then this waits for it to land in byContent. If the owner is a prefetch nobody
+    // has load()ed, it would never land, so it's promoted into an entry of its own, with the alias's
+    // reference as its first one. Can grow the table.
+    bool resolveAlias(unsigned int handle)
+    {
+        if (entries[handle].state != ALIAS_PENDING)
+            return false;
+        uint64_t contentHash = entries[handle].contentHash;
+        unsigned int owner = 0;
+        unordered_map<uint64_t, unsigned int>::iterator found = byContent.find(contentHash);
+        if (found != byContent.end()) {
+            owner = found->second;
+            if (entries[handle].refs)
+                entries[owner].refs++;
+        } else if (entries[handle].refs) {
+            string ownerKey;
+            {
+                lock_guard<mutex> lock(claimMutex);
+                unordered_map<uint64_t, string>::iterator claim = claimedContent.find(contentHash);
+                if (claim != claimedContent.end())
+                    ownerKey = claim->second;
+            }
+            unordered_map<string, Entry>::iterator pending = prefetched.find(ownerKey);
+            if (pending == prefetched.end())
+                return false;
+            Entry promoted = std::move(pending->second);
+            prefetched.erase(pending);
+            owner = addEntry(std::move(promoted));
+        }
+
+        Entry &entry = entries[handle];
+        if (entry.refs)
+            entry.canonical = owner;
+        entry.state = entry.refs ? READY : RELEASED;
+        return true;
+    }
+
+    void releaseLocked(unsigned int handle)
+    {
+        if (handle == PLACEHOLDER)
+            return;
+        Entry &entry = entries[handle];
+        if (entry.refs == 0 || --entry.refs > 0)
+            return;
+        byPath.erase(entry.key);
+        if (entry.canonical != handle)
+            releaseLocked(entry.canonical);
+        else if (entry.state == READY || entry.state == FAILED)
+            drop(handle);
+        // entries still in flight are dropped by update() once they land
+    }
+
+    void drop(unsigned int handle)
+    {
+        Entry &entry = entries[handle];
+        if (entry.name)
+            glState().deleteTexture(entry.name);
+        entry.name = 0;
+        entry.state = RELEASED;
+        // forget the content too, so the next file with these bytes gets decoded again
+        unordered_map<uint64_t, unsigned int>::iterator owner = byContent.find(entry.contentHash);
+        if (owner != byContent.end() && owner->second == handle) {
+            byContent.erase(owner);
+            lock_guard<mutex> lock(claimMutex);
+            claimedContent.erase(entry.contentHash);
+        }
+    }
+
+    static string makeKey(const string &path, bool flip, bool clampTransparent)
+    {
+        return FileSystem::normalize(path) + (flip ? "|flip" : "") + (clampTransparent ? "|clamp" : "");
+    }
+
+    unsigned int addEntry(Entry entry)
+    {
+        unsigned int handle = (unsigned int) entries.size();
+        entry.refs = 1;
+        entry.canonical = handle;
+        byPath[entry.key] = handle;
+        entries.push_back(std::move(entry));
+        inFlight.push_back(handle);
+        return handle;
+    }
+
+    future<Decoded> submitDecode(const string &key, const string &path, bool flip, bool clampTransparent)
+    {
+        // the load flags are part of the content key, the same bytes flipped are a different texture
+        uint64_t salt = (flip ? 1 : 0) | (clampTransparent ? 2 : 0);
+        return workerPool().submit([this, key, path, flip, salt] {
+            Decoded decoded;
+            vector<unsigned char> bytes;
+            if (!readFileBytes(path, bytes)) {
+                decoded.contentHash = hashBytes64((const unsigned char *) path.data(), path.size());
+                return decoded;
+            }
+            decoded.contentHash = hashBytes64(bytes.data(), bytes.size()) ^ salt;
+            {
+                lock_guard<mutex> lock(claimMutex);
+                decoded.duplicate = !claimedContent.insert(make_pair(decoded.contentHash, key)).second;
+            }
+            if (!decoded.duplicate)
+                decoded.image = decodeImage(bytes, path, flip);
+            return decoded;
+        });
+    }
+
+    template<typename T>
+    static bool isDone(const future<T> &f)
+    {
+        return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    template<typename T>
+    static bool allDone(const vector<future<T>> &futures)
+    {
+        for (const future<T> &f : futures)
+            if (!isDone(f))
+                return false;
+        return true;
+    }
+
+    void createPlaceholders()
+    {
+        if (placeholder)
+            return;
+        const unsigned char grey[4] = {128, 128, 128, 255};
+        glGenTextures(1, &placeholder);
+        glState().bindTexture(0, GL_TEXTURE_2D, placeholder);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        entries[PLACEHOLDER].name = placeholder;
+
+        glGenTextures(1, &placeholderCube);
+        glState().bindTexture(0, GL_TEXTURE_CUBE_MAP, placeholderCube);
+        for (unsigned int i = 0; i < 6; i++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    // maps a PBO for the decoded pixels and lets a worker fill it, the GL thread never touches the pixels.
+    void startCopy(Entry &entry, size_t size)
+    {
+        if (freeBuffers.empty()) {
+            unsigned int buffer;
+            glGenBuffers(1, &buffer);
+            freeBuffers.push_back(buffer);
+        }
+        entry.pbo = freeBuffers.back();
+        freeBuffers.pop_back();
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, entry.pbo);
+        // orphan the previous storage so reusing the buffer never waits for an earlier upload
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        void *destination = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        entry.mapped = destination != nullptr;
+        if (entry.mapped) {
+            const unsigned char *source = entry.image.data;
+            entry.copying = workerPool().submit([destination, source, size] { memcpy(destination, source, size); });
+        } else {
+            promise<void> nothingToCopy;
+            nothingToCopy.set_value();
+            entry.copying = nothingToCopy.get_future();
+        }
+        entry.state = COPYING;
+    }
+
+    void finishUpload(Entry &entry)
+    {
+        // if mapping failed or the mapping got lost, fall back to sourcing the pixels from client memory
+        bool mapped = false;
+        if (entry.mapped) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, entry.pbo);
+            mapped = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+            if (!mapped)
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        const Image &image = entry.image;
+        GLenum format = image.format();
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState().bindTexture(0, GL_TEXTURE_2D, texture);
+        // rows of 1 and 3 channel images are tightly packed, not 4-byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, mapped ? (void *) 0 : image.data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        GLint wrap = entry.clampTransparent && format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        freeBuffers.push_back(entry.pbo);
+        entry.pbo = 0;
+        entry.image.release();
+        entry.name = texture;
+        entry.state = READY;
+    }
+
+    // cube maps are only loaded at startup, their faces go up straight from client memory
+    bool uploadCubemap(Entry &entry)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glState().bindTexture(0, GL_TEXTURE_CUBE_MAP, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (unsigned int i = 0; i < entry.faces.size(); i++)
+        {
+            Image face = entry.faces[i].get();
+            if (face.data)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, face.width, face.height, 0, face.format(), GL_UNSIGNED_BYTE, face.data);
+            else
+                std::cout << "Cubemap texture failed to load at path: " << face.path << std::endl;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        entry.faces.clear();
+        entry.name = texture;
+        entry.state = READY;
+        return true;
+    }
+};
+
+// process-wide registry, shared by every model and the helpers in main.cpp.
+inline TextureLoader &textureLoader()
+{
+    static TextureLoader loader;
+    return loader;
+}
+#endif
@@ -0,0 +1,155 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed-size pool of worker threads consuming a FIFO of tasks.
+// Tasks must not touch OpenGL: the context is only current on the main thread.
+// Urgent tasks have a FIFO of their own that the workers drain first, for the frame's work that the
+// GL thread waits on, so it doesn't queue up behind texture decodes.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount) : stopping(false)
+    {
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // queues a task and returns a future for its result.
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> submit(F task)
+    {
+        return push(std::move(task), tasks);
+    }
+
+    // queues a task ahead of everything submit() queued.
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> submitUrgent(F task)
+    {
+        return push(std::move(task), urgentTasks);
+    }
+
+    unsigned int size() const { return (unsigned int) workers.size(); }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::queue<std::function<void()>> urgentTasks;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping;
+
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> push(F task, std::queue<std::function<void()>> &queue)
+    {
+        typedef typename std::result_of<F()>::type Result;
+        // std::function needs a copyable callable, so the packaged_task lives behind a shared_ptr
+        std::shared_ptr<std::packaged_task<Result()>> packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push([packaged] { (*packaged)(); });
+        }
+        wakeUp.notify_one();
+        return result;
+    }
+
+    void workerLoop()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this] { return stopping || !tasks.empty() || !urgentTasks.empty(); });
+                if (stopping && tasks.empty() && urgentTasks.empty())
+                    return;
+                std::queue<std::function<void()>> &queue = urgentTasks.empty() ? tasks : urgentTasks;
+                task = std::move(queue.front());
+                queue.pop();
+            }
+            task();
+        }
+    }
+};
+
+// process-wide pool, one worker per core minus the one driving the GL context.
+inline ThreadPool &workerPool()
+{
+    static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+// number of chunks parallelFor splits count items into
+inline unsigned int parallelChunks(size_t count, size_t minChunk)
+{
+    size_t chunks = (count + minChunk - 1) / std::max<size_t>(minChunk, 1);
+    return (unsigned int) std::max<size_t>(1, std::min<size_t>(chunks, workerPool().size() + 1));
+}
+
+// bookkeeping of one parallelFor, shared with helpers that may only get to run after it returned
+struct ParallelForState {
+    std::atomic<unsigned int> next;     // first chunk nobody has claimed yet
+    unsigned int chunks;
+    unsigned int done;
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    explicit ParallelForState(unsigned int chunks) : next(0), chunks(chunks), done(0) {}
+};
+
+// calls task(chunk, begin, end) for parallelChunks(count, minChunk) contiguous chunks of [0, count),
+// on the worker pool and the calling thread, and returns once all of them are done. Chunks are numbered
+// in order, so per-chunk output merged by chunk comes out in item order, whichever thread ran them.
+//
+// The chunks aren't tied to tasks: the calling thread and urgent helpers on the pool claim them one by
+// one, so when the workers are busy decoding the caller ends up running the chunks itself instead of
+// waiting for the pool. It only waits for chunks a helper already started.
+template<typename F>
+void parallelFor(size_t count, size_t minChunk, F task)
+{
+    unsigned int chunks = parallelChunks(count, minChunk);
+    size_t size = (count + chunks - 1) / chunks;
+    std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>(chunks);
+    // task is only touched after claiming a chunk, and every claimed chunk finishes before this returns
+    F *body = &task;
+    std::function<void()> run = [state, body, count, size] {
+        for (unsigned int chunk = state->next++; chunk < state->chunks; chunk = state->next++) {
+            size_t begin = std::min(count, chunk * size), end = std::min(count, begin + size);
+            (*body)(chunk, begin, end);
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (++state->done == state->chunks)
+                state->finished.notify_all();
+        }
+    };
+    for (unsigned int helper = 1; helper < chunks; helper++)
+        workerPool().submitUrgent(run);
+    run();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state] { return state->done == state->chunks; });
+}
+#endif
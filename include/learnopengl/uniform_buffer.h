@@ -0,0 +1,93 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstring>
+
+// Uniform blocks shared by every program. Shader binds any of these it finds to its fixed binding
+// point right after linking, so a new shader picks them up without extra per-frame uniform calls.
+enum UniformBlockBinding {
+    FRAME_DATA_BINDING = 0,
+    LIGHTS_BINDING = 1,
+    CLUSTERS_BINDING = 2,
+    UNIFORM_BLOCK_COUNT
+};
+
+// block names, indexed by UniformBlockBinding
+static const char *const UNIFORM_BLOCK_NAMES[UNIFORM_BLOCK_COUNT] = { "FrameData", "Lights", "Clusters" };
+
+// The structs below mirror the std140 blocks in the shaders member for member, vec3s are padded to 16 bytes.
+//
+// layout (std140) uniform FrameData {
+//     mat4 projection;
+//     mat4 view;
+//     vec4 viewPosition; // w: time in seconds
+// };
+struct FrameData {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 viewPosition;
+};
+
+struct DirLightData {
+    glm::vec3 direction; float padding0;
+    glm::vec3 ambient;   float padding1;
+    glm::vec3 diffuse;   float padding2;
+    glm::vec3 specular;  float padding3;
+};
+
+// layout (std140) uniform Lights {
+//     DirLight dirLight;
+// };
+// the point lights are clustered, see light_clusters.h
+struct LightsData {
+    DirLightData dirLight;
+};
+
+// layout (std140) uniform Clusters {
+//     uvec4 clusterGrid;      // tiles in x and y, depth slices, lights
+//     vec4 clusterParams;     // tile size in pixels, depth slice scale and bias
+// };
+struct ClusterData {
+    glm::uvec4 grid;
+    glm::vec4 params;
+};
+
+// Buffer backing one uniform block. update() compares against the last upload and only touches
+// the buffer when something changed, so static data like the lights costs nothing per frame.
+template<typename T>
+class UniformBuffer
+{
+public:
+    explicit UniformBuffer(UniformBlockBinding binding) : ID(0), current(), uploaded(false)
+    {
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+    // returns true if the contents changed and were uploaded
+    bool update(const T &data)
+    {
+        if (uploaded && memcmp(&current, &data, sizeof(T)) == 0)
+            return false;
+        current = data;
+        uploaded = true;
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &current);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        return true;
+    }
+
+    unsigned int ID;
+
+private:
+    T current;
+    bool uploaded;
+};
+#endif
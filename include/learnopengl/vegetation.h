@@ -0,0 +1,134 @@
+#ifndef VEGETATION_H
+#define VEGETATION_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+using namespace std;
+
+// Field of alpha-tested grass clumps drawn with a single glDrawArraysInstanced call.
+//
+// Every clump is two crossed quads; position, rotation, scale and tint are per-instance attributes
+// in a static buffer filled once at startup, so the CPU cost per frame doesn't depend on the number
+// of blades. Wind sway and the distance based thinning happen in trava.vs.
+class VegetationField
+{
+public:
+    // per-instance data, matches attribute locations 2 and 3 in trava.vs
+    struct Instance {
+        glm::vec4 positionRotation; // xyz: base of the clump, w: rotation around Y in radians
+        glm::vec4 tintScale;        // rgb: color multiplier, a: uniform scale
+    };
+
+    VegetationField() : VAO(0), bladeVBO(0), instanceVBO(0), uploadedCount(0)
+    {
+    }
+
+    ~VegetationField()
+    {
+        if (VAO)
+            glState().deleteVertexArray(VAO);
+        if (bladeVBO)
+            glDeleteBuffers(1, &bladeVBO);
+        if (instanceVBO)
+            glDeleteBuffers(1, &instanceVBO);
+    }
+
+    VegetationField(const VegetationField &) = delete;
+    VegetationField &operator=(const VegetationField &) = delete;
+
+    // scatters count clumps uniformly over a disc of the given radius around center, at center's height.
+    // the seed keeps the layout identical from run to run.
+    void addPatch(glm::vec3 center, float radius, unsigned int count, unsigned int seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        instances.reserve(instances.size() + count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            // sqrt keeps the density even instead of bunching up at the center
+            float distance = radius * std::sqrt(unit(random));
+            float angle = 6.2831853f * unit(random);
+            Instance instance;
+            instance.positionRotation = glm::vec4(center.x + distance * std::cos(angle), center.y,
+                                                  center.z + distance * std::sin(angle), 6.2831853f * unit(random));
+            float shade = 0.75f + 0.35f * unit(random);
+            instance.tintScale = glm::vec4(shade * (0.9f + 0.1f * unit(random)), shade, shade * (0.8f + 0.2f * unit(random)),
+                                           0.18f + 0.17f * unit(random));
+            instances.push_back(instance);
+        }
+    }
+
+    // creates the buffers, call once on the GL thread after the patches are added
+    void Upload()
+    {
+        // two quads crossed at right angles, standing on y = 0
+        float bladeVertices[] = {
+                // positions          // texture Coords
+                -0.5f, 1.0f,  0.0f,   0.0f, 0.0f,
+                -0.5f, 0.0f,  0.0f,   0.0f, 1.0f,
+                 0.5f, 0.0f,  0.0f,   1.0f, 1.0f,
+                -0.5f, 1.0f,  0.0f,   0.0f, 0.0f,
+                 0.5f, 0.0f,  0.0f,   1.0f, 1.0f,
+                 0.5f, 1.0f,  0.0f,   1.0f, 0.0f,
+
+                 0.0f, 1.0f, -0.5f,   0.0f, 0.0f,
+                 0.0f, 0.0f, -0.5f,   0.0f, 1.0f,
+                 0.0f, 0.0f,  0.5f,   1.0f, 1.0f,
+                 0.0f, 1.0f, -0.5f,   0.0f, 0.0f,
+                 0.0f, 0.0f,  0.5f,   1.0f, 1.0f,
+                 0.0f, 1.0f,  0.5f,   1.0f, 0.0f
+        };
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &bladeVBO);
+        glGenBuffers(1, &instanceVBO);
+        glState().bindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, bladeVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(bladeVertices), bladeVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, positionRotation));
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, tintScale));
+        glVertexAttribDivisor(3, 1);
+
+        glState().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        uploadedCount = (unsigned int) instances.size();
+        // the GPU copy is all that's needed from here on
+        vector<Instance>().swap(instances);
+    }
+
+    // draws the whole field with the bound shader, its wind and density uniforms are set by the caller
+    void Draw(unsigned int texture)
+    {
+        glState().bindTexture(0, GL_TEXTURE_2D, texture);
+        glState().bindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 12, uploadedCount);
+    }
+
+    unsigned int size() const { return uploadedCount; }
+
+private:
+    vector<Instance> instances;
+    unsigned int VAO, bladeVBO, instanceVBO;
+    unsigned int uploadedCount;
+};
+#endif
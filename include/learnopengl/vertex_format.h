@@ -0,0 +1,211 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// Vertex packed into 20 bytes instead of 56:
+//   position  - 16-bit unsigned normalized against the mesh bounding box, decoded with the
+//               mesh's positionScale/positionOffset. w holds the bitangent sign (0 or 1).
+//   normal    - octahedral encoding, two 16-bit signed normalized components
+//   tangent   - octahedral encoding as well, the bitangent is cross(normal, tangent) * sign
+//   texCoords - half floats
+struct CompactVertex {
+    uint16_t Position[4];
+    int16_t  Normal[2];
+    int16_t  Tangent[2];
+    uint16_t TexCoords[2];
+};
+
+enum VertexFormat {
+    VERTEX_FLOAT = 0,   // Vertex
+    VERTEX_COMPACT = 1  // CompactVertex
+};
+
+// how a mesh's vertex buffer is laid out and how to get object space positions back out of it.
+// plain old data, it is stored as-is in the mesh cache.
+struct VertexEncoding {
+    uint32_t format;
+    float positionScale[3];
+    float positionOffset[3];
+
+    VertexEncoding() : format(VERTEX_FLOAT)
+    {
+        for (int i = 0; i < 3; i++) {
+            positionScale[i] = 1.0f;
+            positionOffset[i] = 0.0f;
+        }
+    }
+};
+
+inline size_t vertexStride(uint32_t format)
+{
+    return format == VERTEX_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+}
+
+// IEEE 754 single to half precision, round to nearest even; out of range values become infinity
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t) ((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) // infinity or NaN
+        return (uint16_t) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31)
+        return (uint16_t) (sign | 0x7c00);
+    if (exponent <= 0) {
+        // subnormal half, or zero once it drops out of range
+        if (exponent < -10)
+            return (uint16_t) sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t) (14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return (uint16_t) (sign | half);
+    }
+    uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++; // a carry into the exponent is still the correctly rounded value
+    return (uint16_t) half;
+}
+
+inline int16_t packSnorm16(float value)
+{
+    return (int16_t) std::round(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+// maps a unit vector onto the octahedron and unfolds it into the [-1, 1] square,
+// decoded by octDecode in the model shader
+inline void octEncode(glm::vec3 v, int16_t out[2])
+{
+    float length = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+    if (length == 0.0f) {
+        // Assimp leaves tangents zero on meshes without texture coordinates
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = v.x / length;
+    float y = v.y / length;
+    if (v.z < 0.0f) {
+        float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    out[0] = packSnorm16(x);
+    out[1] = packSnorm16(y);
+}
+
+// packs vertices into CompactVertex, the bounding box used for the positions is returned in encoding.
+inline void quantizeVertices(const vector<Vertex> &vertices, vector<CompactVertex> &compact, VertexEncoding &encoding)
+{
+    glm::vec3 minimum(0.0f), maximum(0.0f);
+    if (!vertices.empty())
+        minimum = maximum = vertices[0].Position;
+    for (const Vertex &vertex : vertices) {
+        minimum = glm::min(minimum, vertex.Position);
+        maximum = glm::max(maximum, vertex.Position);
+    }
+    glm::vec3 extent = maximum - minimum;
+
+    encoding.format = VERTEX_COMPACT;
+    for (int i = 0; i < 3; i++) {
+        encoding.positionScale[i] = extent[i];
+        encoding.positionOffset[i] = minimum[i];
+    }
+
+    compact.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex &vertex = vertices[i];
+        CompactVertex &packed = compact[i];
+        for (int k = 0; k < 3; k++) {
+            float unit = extent[k] > 0.0f ? (vertex.Position[k] - minimum[k]) / extent[k] : 0.0f;
+            packed.Position[k] = (uint16_t) std::round(std::min(std::max(unit, 0.0f), 1.0f) * 65535.0f);
+        }
+        bool rightHanded = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) >= 0.0f;
+        packed.Position[3] = rightHanded ? 65535 : 0;
+        octEncode(vertex.Normal, packed.Normal);
+        octEncode(vertex.Tangent, packed.Tangent);
+        packed.TexCoords[0] = floatToHalf(vertex.TexCoords.x);
+        packed.TexCoords[1] = floatToHalf(vertex.TexCoords.y);
+    }
+}
+
+// object space position of vertex i of a vertex buffer in the given encoding, for CPU side uses of the geometry
+inline glm::vec3 vertexPosition(const void *vertices, size_t i, const VertexEncoding &encoding)
+{
+    if (encoding.format != VERTEX_COMPACT)
+        return ((const Vertex *) vertices)[i].Position;
+    const CompactVertex &vertex = ((const CompactVertex *) vertices)[i];
+    glm::vec3 position;
+    for (int k = 0; k < 3; k++)
+        position[k] = encoding.positionOffset[k] + encoding.positionScale[k] * (vertex.Position[k] / 65535.0f);
+    return position;
+}
+
+// sets up attribute locations 0-4 for the bound VAO and vertex buffer.
+// VERTEX_FLOAT: position, normal, texCoords, tangent, bitangent as floats.
+// VERTEX_COMPACT: position (xyz + bitangent sign), octahedral normal, texCoords, octahedral tangent;
+// location 4 is left disabled, shaders rebuild the bitangent from the sign.
+inline void setVertexAttributes(uint32_t format)
+{
+    if (format == VERTEX_COMPACT) {
+        GLsizei stride = sizeof(CompactVertex);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, Position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(CompactVertex, TexCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, Tangent));
+        glDisableVertexAttribArray(4);
+        return;
+    }
+
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    // vertex tangent
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+    // vertex bitangent
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+}
+#endif
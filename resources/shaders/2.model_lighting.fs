@@ -1,6 +1,7 @@
 #version 330 core
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
+
+// variants (see shader_variants.h): NO_SPECULAR, HAS_NORMALMAP, IMPOSTOR_FADE
 
 struct DirLight {
     vec3 direction;
@@ -10,84 +11,111 @@ struct DirLight {
     vec3 specular;
 };
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-
 struct Material {
     sampler2D texture_diffuse1;
+#ifndef NO_SPECULAR
     sampler2D texture_specular1;
+#endif
+#ifdef HAS_NORMALMAP
+    sampler2D texture_normal1;
+#endif
 
     float shininess;
 };
 
-#define NR_POINT_LIGHT 4
-
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+flat in vec3 InstanceOrigin;
+#ifdef HAS_NORMALMAP
+in vec3 Tangent;
+in vec3 Bitangent;
+#endif
+
+// shared by every program and updated once per frame, see uniform_buffer.h
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition; // w: time in seconds
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+};
+
+#include "clustered_lights.glsl"
+#ifdef IMPOSTOR_FADE
+#include "impostor_fade.glsl"
+#endif
 
-uniform DirLight dirLight;
-uniform PointLight pointLight[NR_POINT_LIGHT];
 uniform Material material;
 
-uniform vec3 viewPosition;
-// calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+// calculates the color when using a point light, albedo and specularMask are the material's samples
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMask)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
+    // attenuation
+    float attenuation = lightAttenuation(light, length(light.position - fragPos));
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+#ifdef NO_SPECULAR
+    return (ambient + diffuse) * attenuation;
+#else
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
+    vec3 specular = light.specular * spec * specularMask;
+    return (ambient + diffuse + specular) * attenuation;
+#endif
 }
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularMask)
 {
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
+    // combine results
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+#ifdef NO_SPECULAR
+    return (ambient + diffuse);
+#else
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 specular = light.specular * spec * specularMask;
     return (ambient + diffuse + specular);
+#endif
 }
 
 void main()
 {
+#ifdef IMPOSTOR_FADE
+    // keeps exactly the pixels the impostor drops
+    if (dither() < impostorFadeAt(InstanceOrigin))
+        discard;
+#endif
     vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 result = CalcDirLight(dirLight, normal, viewDir);
-   for(int i = 0; i < NR_POINT_LIGHT; i++)
-           result += CalcPointLight(pointLight[i], normal, FragPos, viewDir);
-    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 1.0)
-            BrightColor = vec4(result, 1.0);
-        else
-            BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+#ifdef HAS_NORMALMAP
+    // the map's tangent space normal, brought into the space of Normal
+    vec3 mapped = texture(material.texture_normal1, TexCoords).rgb * 2.0 - 1.0;
+    normal = normalize(mat3(normalize(Tangent), normalize(Bitangent), normal) * mapped);
+#endif
+    vec3 viewDir = normalize(viewPosition.xyz - FragPos);
+    // the material is sampled once here instead of in every light
+    vec3 albedo = texture(material.texture_diffuse1, TexCoords).rgb;
+#ifdef NO_SPECULAR
+    float specularMask = 0.0;
+#else
+    float specularMask = texture(material.texture_specular1, TexCoords).r;
+#endif
+    vec3 result = CalcDirLight(dirLight, normal, viewDir, albedo, specularMask);
+    // only the lights that reach this fragment's cluster
+    uvec2 cluster = clusterOf(FragPos);
+    for (uint i = 0u; i < cluster.y; i++)
+        result += CalcPointLight(clusterLight(cluster, i), normal, FragPos, viewDir, albedo, specularMask);
     FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
@@ -1,20 +1,66 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec4 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef HAS_NORMALMAP
+// float vertices: tangent and bitangent, compact ones: octahedral tangent, the bitangent sign is in aPos.w
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+#endif
+layout (location = 5) in mat4 aInstanceModel;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+flat out vec3 InstanceOrigin;
+#ifdef HAS_NORMALMAP
+out vec3 Tangent;
+out vec3 Bitangent;
+#endif
+// the depth prepass runs this shader in another program, the color pass tests GL_EQUAL against it
+invariant gl_Position;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// shared by every program, see uniform_buffer.h
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition; // w: time in seconds
+};
+// set by Model::DrawInstanced, the model matrix then comes from the instance attribute
+uniform bool instanced;
+
+// compact vertices (see vertex_format.h): positions are normalized against the mesh bounds,
+// normals are octahedral encoded in aNormal.xy
+uniform bool compactVertices;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    vec3 position = aPos.xyz;
+    vec3 normal = aNormal;
+    if (compactVertices)
+    {
+        position = aPos.xyz * positionScale + positionOffset;
+        normal = octDecode(aNormal.xy);
+    }
+#ifdef HAS_NORMALMAP
+    Tangent = compactVertices ? octDecode(aTangent.xy) : aTangent;
+    Bitangent = compactVertices ? cross(normal, Tangent) * (aPos.w > 0.5 ? 1.0 : -1.0) : aBitangent;
+#endif
+    mat4 modelMatrix = instanced ? aInstanceModel : model;
+    FragPos = vec3(modelMatrix * vec4(position, 1.0));
+    InstanceOrigin = modelMatrix[3].xyz;
+    Normal = normal;
     TexCoords = aTexCoords;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,69 @@
+#version 460 core
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+#ifdef HAS_NORMALMAP
+// float vertices: tangent and bitangent, compact ones: octahedral tangent, the bitangent sign is in aPos.w
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+#endif
+layout (location = 5) in mat4 aInstanceModel;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+flat out vec3 InstanceOrigin;
+#ifdef HAS_NORMALMAP
+out vec3 Tangent;
+out vec3 Bitangent;
+#endif
+// the depth prepass runs this shader in another program, the color pass tests GL_EQUAL against it
+invariant gl_Position;
+
+// 2.model_lighting.vs for the multi-draw-indirect backend (see RenderQueue), paired with the same
+// fragment shader. Always instanced, the per-mesh position decoding of draw gl_DrawID of the
+// multi-draw is at drawData[(drawDataBase + gl_DrawID) * 2]: scale, then offset.
+
+// shared by every program, see uniform_buffer.h
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition; // w: time in seconds
+};
+
+layout (std430, binding = 0) readonly buffer DrawData {
+    vec4 drawData[];
+};
+uniform int drawDataBase;
+
+// compact vertices (see vertex_format.h), the same for every mesh of an arena pool
+uniform bool compactVertices;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+void main()
+{
+    vec3 position = aPos.xyz;
+    vec3 normal = aNormal;
+    if (compactVertices)
+    {
+        int draw = (drawDataBase + gl_DrawID) * 2;
+        position = aPos.xyz * drawData[draw].xyz + drawData[draw + 1].xyz;
+        normal = octDecode(aNormal.xy);
+    }
+#ifdef HAS_NORMALMAP
+    Tangent = compactVertices ? octDecode(aTangent.xy) : aTangent;
+    Bitangent = compactVertices ? cross(normal, Tangent) * (aPos.w > 0.5 ? 1.0 : -1.0) : aBitangent;
+#endif
+    FragPos = vec3(aInstanceModel * vec4(position, 1.0));
+    InstanceOrigin = aInstanceModel[3].xyz;
+    Normal = normal;
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
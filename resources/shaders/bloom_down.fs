@@ -0,0 +1,72 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// one step down the bloom chain (see bloom.h): a 13-tap filter over the level above, four
+// overlapping 2x2 boxes around the center and one in it, so the result doesn't flicker when bright
+// pixels move. BLOOM_PREFILTER is the first step, from the scene itself: it keeps only what is
+// brighter than threshold and weighs the boxes by their brightness, so a single very bright pixel
+// can't blow up into a blinking square.
+uniform sampler2D source;
+uniform float threshold;
+
+#ifdef BLOOM_PREFILTER
+float luminance(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// soft knee, the bright pass fades in over half the threshold instead of cutting off
+vec3 brightPass(vec3 color)
+{
+    float brightness = luminance(color);
+    float knee = threshold * 0.5;
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 0.0001);
+    float contribution = max(soft, brightness - threshold) / max(brightness, 0.0001);
+    return color * contribution;
+}
+
+// Karis average: every box weighs 1 / (1 + its brightness) instead of its share of the footprint
+vec3 combine(vec3 center, vec3 box1, vec3 box2, vec3 box3, vec3 box4)
+{
+    float w0 = 1.0 / (1.0 + luminance(center));
+    float w1 = 1.0 / (1.0 + luminance(box1));
+    float w2 = 1.0 / (1.0 + luminance(box2));
+    float w3 = 1.0 / (1.0 + luminance(box3));
+    float w4 = 1.0 / (1.0 + luminance(box4));
+    return (center * w0 + box1 * w1 + box2 * w2 + box3 * w3 + box4 * w4) / (w0 + w1 + w2 + w3 + w4);
+}
+#else
+// the center box counts half, the four around it an eighth each
+vec3 combine(vec3 center, vec3 box1, vec3 box2, vec3 box3, vec3 box4)
+{
+    return center * 0.5 + (box1 + box2 + box3 + box4) * 0.125;
+}
+#endif
+
+void main()
+{
+    vec2 texel = 1.0 / textureSize(source, 0);
+    vec3 a = texture(source, TexCoords + texel * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(source, TexCoords + texel * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(source, TexCoords + texel * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(source, TexCoords + texel * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(source, TexCoords).rgb;
+    vec3 f = texture(source, TexCoords + texel * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(source, TexCoords + texel * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(source, TexCoords + texel * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(source, TexCoords + texel * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(source, TexCoords + texel * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(source, TexCoords + texel * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(source, TexCoords + texel * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(source, TexCoords + texel * vec2( 1.0, -1.0)).rgb;
+
+    vec3 result = combine((j + k + l + m) * 0.25, (a + b + d + e) * 0.25, (b + c + e + f) * 0.25,
+                          (d + e + g + h) * 0.25, (e + f + h + i) * 0.25);
+#ifdef BLOOM_PREFILTER
+    result = brightPass(result);
+#endif
+    FragColor = vec4(max(result, vec3(0.0)), 1.0);
+}
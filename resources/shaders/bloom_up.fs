@@ -0,0 +1,23 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// one step up the bloom chain (see bloom.h): a 3x3 tent over the smaller level, added onto the
+// larger one by blending
+uniform sampler2D source;
+
+void main()
+{
+    vec2 texel = 1.0 / textureSize(source, 0);
+    vec3 result = texture(source, TexCoords).rgb * 4.0;
+    result += (texture(source, TexCoords + texel * vec2(-1.0,  0.0)).rgb
+             + texture(source, TexCoords + texel * vec2( 1.0,  0.0)).rgb
+             + texture(source, TexCoords + texel * vec2( 0.0, -1.0)).rgb
+             + texture(source, TexCoords + texel * vec2( 0.0,  1.0)).rgb) * 2.0;
+    result += texture(source, TexCoords + texel * vec2(-1.0, -1.0)).rgb
+            + texture(source, TexCoords + texel * vec2( 1.0, -1.0)).rgb
+            + texture(source, TexCoords + texel * vec2(-1.0,  1.0)).rgb
+            + texture(source, TexCoords + texel * vec2( 1.0,  1.0)).rgb;
+    FragColor = vec4(result / 16.0, 1.0);
+}
@@ -0,0 +1,54 @@
+// the point lights, sorted into a grid of screen tiles and depth slices on the CPU (see
+// light_clusters.h). Shared by 2.model_lighting.fs and impostor.fs, needs the FrameData block.
+
+struct PointLight {
+    vec3 position;
+    float radius;
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+};
+
+layout (std140) uniform Clusters {
+    uvec4 clusterGrid;      // tiles in x and y, depth slices, lights
+    vec4 clusterParams;     // tile size in pixels, depth slice scale and bias
+};
+uniform samplerBuffer lightData;        // four texels per light, in PointLight order
+uniform usamplerBuffer clusterLights;   // per cluster: first entry in lightIndices, count
+uniform usamplerBuffer lightIndices;
+
+PointLight fetchLight(int index)
+{
+    vec4 texels[4];
+    for (int i = 0; i < 4; i++)
+        texels[i] = texelFetch(lightData, index * 4 + i);
+    return PointLight(texels[0].xyz, texels[0].w, texels[1].xyz, texels[1].w, texels[2].xyz, texels[2].w, texels[3].xyz, texels[3].w);
+}
+
+// first entry in lightIndices and light count of the cluster holding a world space position
+uvec2 clusterOf(vec3 position)
+{
+    float depth = max(-(view * vec4(position, 1.0)).z, 1e-4);
+    uint slice = uint(clamp(log(depth) * clusterParams.z + clusterParams.w, 0.0, float(clusterGrid.z - 1u)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterParams.xy), clusterGrid.xy - 1u);
+    return texelFetch(clusterLights, int((slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x)).xy;
+}
+
+// the i-th light of a cluster
+PointLight clusterLight(uvec2 cluster, uint i)
+{
+    return fetchLight(int(texelFetch(lightIndices, int(cluster.x + i)).r));
+}
+
+// attenuation of a light at a distance, faded out towards its radius, past which the clusters don't list it
+float lightAttenuation(PointLight light, float distance)
+{
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float reach = distance / light.radius;
+    reach *= reach;
+    float window = clamp(1.0 - reach * reach, 0.0, 1.0);
+    return attenuation * window * window;
+}
@@ -0,0 +1,24 @@
+#version 330 core
+// depth only pass of the lit models (see RenderQueue), paired with the model's vertex shader.
+// Nothing to write, and without IMPOSTOR_FADE no discard either, so early-Z stays on. With it the
+// pass drops exactly the pixels 2.model_lighting.fs drops, so the color pass finds the depth it expects.
+flat in vec3 InstanceOrigin;
+
+// shared by every program and updated once per frame, see uniform_buffer.h
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition; // w: time in seconds
+};
+
+#ifdef IMPOSTOR_FADE
+#include "impostor_fade.glsl"
+#endif
+
+void main()
+{
+#ifdef IMPOSTOR_FADE
+    if (dither() < impostorFadeAt(InstanceOrigin))
+        discard;
+#endif
+}
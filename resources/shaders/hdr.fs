@@ -1,36 +1,29 @@
-     #version 330 core
-     out vec4 FragColor;
+#version 330 core
+out vec4 FragColor;
 
-     in vec2 TexCoords;
+in vec2 TexCoords;
 
-     uniform sampler2D hdrBuffer;
-     uniform sampler2D bloomBlur;
-     uniform bool hdr;
-     uniform bool bloom;
-     uniform float exposure;
+// variants (see shader_variants.h): HDR_OFF skips the tone mapping, BLOOM_OFF the bloom
+uniform sampler2D hdrBuffer;
+#ifndef BLOOM_OFF
+uniform sampler2D bloomBlur;
+uniform float bloomStrength;
+#endif
+uniform float exposure;
 
-     void main()
-     {
-         const float gamma = 2.2;
-         vec3 hdrColor = texture(hdrBuffer, TexCoords).rgb;
-         vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
+void main()
+{
+    const float gamma = 2.2;
+    vec3 hdrColor = texture(hdrBuffer, TexCoords).rgb;
+#ifndef BLOOM_OFF
+    hdrColor += texture(bloomBlur, TexCoords).rgb * bloomStrength;
+#endif
 
-
-         if (bloom) {
-                 hdrColor += bloomColor;
-             }
-
-        vec3 result = hdrColor;
-         if(hdr)
-         {
-
-             result = vec3(1.0) - exp(-hdrColor * exposure);
-             result = pow(result, vec3(1.0 / gamma));
-             FragColor = vec4(result, 1.0);
-         }
-         else
-         {
-             vec3 result = pow(hdrColor, vec3(1.0 / gamma));
-             FragColor = vec4(result, 1.0);
-         }
-     }
\ No newline at end of file
+#ifdef HDR_OFF
+    vec3 result = hdrColor;
+#else
+    vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
+#endif
+    result = pow(result, vec3(1.0 / gamma));
+    FragColor = vec4(result, 1.0);
+}
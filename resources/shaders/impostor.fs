@@ -0,0 +1,84 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+in vec2 FrameUV;
+in vec3 FragPos;
+flat in vec2 BaseFrame;
+flat in vec4 FrameWeights;
+flat in vec3 DepthAxis;
+flat in vec3 InstanceOrigin;
+
+// shared by every program and updated once per frame, see uniform_buffer.h
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition; // w: time in seconds
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+};
+
+#include "clustered_lights.glsl"
+#include "impostor_fade.glsl"
+
+uniform sampler2D impostorAlbedo;
+uniform sampler2D impostorNormalDepth;
+uniform float frames;
+
+// the lights of 2.model_lighting.fs without the specular term, too small to matter this far out
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 albedo)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    return (light.ambient + light.diffuse * diff) * albedo;
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 albedo)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float attenuation = lightAttenuation(light, length(light.position - fragPos));
+    return (light.ambient + light.diffuse * diff) * albedo * attenuation;
+}
+
+void main()
+{
+    // the mesh covers the pixels this one leaves out, see 2.model_lighting.fs
+    if (dither() >= impostorFadeAt(InstanceOrigin))
+        discard;
+
+    vec4 albedo = vec4(0.0);
+    vec4 normalDepth = vec4(0.0);
+    for (int i = 0; i < 4; i++)
+    {
+        vec2 uv = (BaseFrame + vec2(i & 1, i >> 1) + FrameUV) / frames;
+        albedo += texture(impostorAlbedo, uv) * FrameWeights[i];
+        normalDepth += texture(impostorNormalDepth, uv) * FrameWeights[i];
+    }
+    if (albedo.a < 0.5)
+        discard;
+    // the atlas is 0 around the model, dividing by the coverage takes that back out of the edges
+    albedo.rgb /= albedo.a;
+    normalDepth /= albedo.a;
+    vec3 normal = normalize(normalDepth.xyz * 2.0 - 1.0);
+
+    // the baked surface point along the view axis, its depth lets impostors intersect like meshes do
+    vec3 surface = FragPos + DepthAxis * (1.0 - 2.0 * normalDepth.w);
+    vec4 clip = projection * view * vec4(surface, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+    vec3 result = CalcDirLight(dirLight, normal, albedo.rgb);
+    uvec2 cluster = clusterOf(surface);
+    for (uint i = 0u; i < cluster.y; i++)
+        result += CalcPointLight(clusterLight(cluster, i), normal, surface, albedo.rgb);
+    FragColor = vec4(result, 1.0);
+}
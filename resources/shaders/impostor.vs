@@ -0,0 +1,57 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;          // quad corner, -1 to 1
+layout (location = 5) in mat4 aInstanceModel;
+
+out vec2 FrameUV;
+out vec3 FragPos;
+flat out vec2 BaseFrame;        // lower left of the 2x2 frames blended, in frames
+flat out vec4 FrameWeights;     // bilinear weights of those frames
+flat out vec3 DepthAxis;        // world space offset from the quad to a point of baked depth 0
+flat out vec3 InstanceOrigin;
+
+// shared by every program, see uniform_buffer.h
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition; // w: time in seconds
+};
+
+// object space bounding sphere and atlas layout, see impostor.h
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+uniform float frames;
+
+// inverse of octDecode in 2.model_lighting.vs
+vec2 octEncode(vec3 v)
+{
+    vec2 e = v.xy / (abs(v.x) + abs(v.y) + abs(v.z));
+    if (v.z < 0.0)
+        e = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+
+void main()
+{
+    mat3 basis = mat3(aInstanceModel);
+    vec3 worldCenter = vec3(aInstanceModel * vec4(boundsCenter, 1.0));
+    vec3 toCamera = normalize(inverse(basis) * (viewPosition.xyz - worldCenter));
+
+    // frame centers sit at half frames, the four around the camera direction get blended
+    vec2 grid = (octEncode(toCamera) * 0.5 + 0.5) * frames - 0.5;
+    vec2 base = clamp(floor(grid), 0.0, frames - 2.0);
+    vec2 f = clamp(grid - base, 0.0, 1.0);
+    BaseFrame = base;
+    FrameWeights = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+
+    // same basis as the baking camera (glm::lookAt in Impostor::bake)
+    vec3 up = abs(toCamera.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(up, toCamera));
+    vec3 quadUp = cross(toCamera, right);
+    vec3 position = boundsCenter + (aCorner.x * right + aCorner.y * quadUp) * boundsRadius;
+
+    FragPos = vec3(aInstanceModel * vec4(position, 1.0));
+    FrameUV = aCorner * 0.5 + 0.5;
+    DepthAxis = basis * (toCamera * boundsRadius);
+    InstanceOrigin = aInstanceModel[3].xyz;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalDepth;
+
+struct Material {
+    sampler2D texture_diffuse1;
+};
+
+in vec2 TexCoords;
+in vec3 Normal;
+in float Depth;
+
+uniform Material material;
+
+void main()
+{
+    // unlit, impostor.fs lights the frames with the scene's lights at runtime
+    Albedo = vec4(texture(material.texture_diffuse1, TexCoords).rgb, 1.0);
+    NormalDepth = vec4(normalize(Normal) * 0.5 + 0.5, clamp(Depth, 0.0, 1.0));
+}
@@ -0,0 +1,43 @@
+#version 330 core
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out float Depth;
+
+// one orthographic view of the model's bounding sphere, set per atlas frame by Impostor::bake
+uniform mat4 bakeViewProjection;
+uniform vec3 bakeEye;       // object space
+uniform vec3 bakeDirection; // from the eye towards the center of the sphere
+uniform float bakeRadius;
+
+// compact vertices, decoded as in 2.model_lighting.vs
+uniform bool compactVertices;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+void main()
+{
+    vec3 position = aPos.xyz;
+    vec3 normal = aNormal;
+    if (compactVertices)
+    {
+        position = aPos.xyz * positionScale + positionOffset;
+        normal = octDecode(aNormal.xy);
+    }
+    Normal = normal;
+    TexCoords = aTexCoords;
+    // 0 at the front of the sphere, 1 at its back
+    Depth = (dot(position - bakeEye, bakeDirection) - bakeRadius) / (2.0 * bakeRadius);
+    gl_Position = bakeViewProjection * vec4(position, 1.0);
+}
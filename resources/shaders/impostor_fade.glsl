@@ -0,0 +1,20 @@
+// the dithered cross fade between a mesh and its impostor (see impostor.h), shared by
+// 2.model_lighting.fs, its depth prepass and impostor.fs. Needs the FrameData block.
+
+// distance band over which the mesh dithers out into the impostor
+uniform vec2 impostorFade;
+
+// 4x4 ordered dither threshold of the pixel, 0 to 1
+float dither()
+{
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+    return (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+}
+
+// how far the placement at origin has faded into its impostor, 0 to 1. The mesh drops the pixels
+// where dither() < fade, the impostor keeps exactly those.
+float impostorFadeAt(vec3 origin)
+{
+    return clamp((length(viewPosition.xyz - origin) - impostorFade.x) / (impostorFade.y - impostorFade.x), 0.0, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition; // w: time in seconds
+};
+
+// unit cube centered on the origin scaled and moved onto the tested bounding box
+uniform vec3 boxCenter;
+uniform vec3 boxSize;
+
+void main()
+{
+    gl_Position = projection * view * vec4(boxCenter + aPos * boxSize, 1.0);
+}
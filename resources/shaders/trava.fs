@@ -2,6 +2,7 @@
 out vec4 FragColor;
 
 in vec2 TexCoords;
+in vec3 Tint;
 
 uniform sampler2D texture1;
 
@@ -10,5 +11,5 @@ void main()
     vec4 texColor = texture(texture1, TexCoords);
     if(texColor.a < 0.1)
         discard;
-    FragColor = texColor;
-}
\ No newline at end of file
+    FragColor = vec4(texColor.rgb * Tint, texColor.a);
+}
@@ -1,16 +1,65 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
+// per-instance, see VegetationField
+layout (location = 2) in vec4 aPositionRotation;
+layout (location = 3) in vec4 aTintScale;
 
 out vec2 TexCoords;
+out vec3 Tint;
+// the depth prepass runs this shader in another program, the color pass tests GL_EQUAL against it
+invariant gl_Position;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition; // w: time in seconds
+};
 uniform bool celShading;
 
+uniform vec2 windDirection;
+uniform float windStrength;
+
+// clumps are thinned out between densityNear and densityFar, keeping minDensity of them beyond
+uniform float densityNear;
+uniform float densityFar;
+uniform float minDensity;
+
+float hash(vec2 p)
+{
+    return fract(sin(dot(p, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
 void main()
 {
+    vec3 base = aPositionRotation.xyz;
+    float scale = aTintScale.a;
+
+    // each clump draws a fixed random rank and survives while the density at its distance is above it
+    float distanceToCamera = length(base - viewPosition.xyz);
+    float density = mix(1.0, minDensity, clamp((distanceToCamera - densityNear) / (densityFar - densityNear), 0.0, 1.0));
+    if (hash(base.xz) > density)
+    {
+        // outside the clip volume, the triangles are dropped before rasterization
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        TexCoords = aTexCoords;
+        Tint = vec3(0.0);
+        return;
+    }
+    // the survivors grow a little to keep the coverage of the thinned out field
+    scale *= inversesqrt(density);
+
+    float s = sin(aPositionRotation.w);
+    float c = cos(aPositionRotation.w);
+    vec3 local = aPos * scale;
+    vec3 world = base + vec3(c * local.x + s * local.z, local.y, -s * local.x + c * local.z);
+
+    // wind bends the tips, a gust travels across the field along the wind direction
+    float phase = dot(base.xz, windDirection) * 0.8 + viewPosition.w * 2.0 + hash(base.zx) * 6.2831853;
+    float sway = (sin(phase) * 0.7 + sin(phase * 2.3) * 0.3) * windStrength * aPos.y * aPos.y * scale;
+    world.xz += windDirection * sway;
+
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    Tint = aTintScale.rgb;
+    gl_Position = projection * view * vec4(world, 1.0);
+}
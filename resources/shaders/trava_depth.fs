@@ -0,0 +1,11 @@
+#version 330 core
+// depth only pass of the grass, the alpha test of trava.fs and nothing else
+in vec2 TexCoords;
+
+uniform sampler2D texture1;
+
+void main()
+{
+    if(texture(texture1, TexCoords).a < 0.1)
+        discard;
+}
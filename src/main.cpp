@@ -9,12 +9,33 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <learnopengl/bloom.h>
 #include <learnopengl/filesystem.h>
+#include <learnopengl/frustum_culler.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/gpu_timer.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
-
+#include <learnopengl/occlusion_queries.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/scene_bvh.h>
+#include <learnopengl/software_occlusion.h>
+#include <learnopengl/image.h>
+#include <learnopengl/impostor.h>
+#include <learnopengl/indirect_draw.h>
+#include <learnopengl/light_clusters.h>
+#include <learnopengl/lod_selector.h>
+#include <learnopengl/mesh_arena.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/vegetation.h>
+
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <random>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -24,12 +45,20 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 
 void processInput(GLFWwindow *window);
 
-unsigned int loadCubemap(vector<std::string> faces);
+unsigned int loadCubemap(vector<std::string> &faces);
 
 unsigned int loadTexture(char const * path);
 
+double millisecondsSince(std::chrono::steady_clock::time_point start);
+
+glm::mat4 placement(glm::vec3 position, glm::vec3 scale, float rotateX = 0.0f, float rotateZ = 0.0f);
+
 void renderQuad();
 
+void renderStateOverlay(const GLStateCache::Counters &counters, const SceneBVH::Stats &scene, unsigned int sceneObjects,
+                        const FrustumCuller::Stats &culling, unsigned int occlusionQueries, const SoftwareOcclusion::Stats &software,
+                        unsigned int meshDrawCalls, const LightClusters::Stats &lighting, float sceneMilliseconds);
+
 // settings
 const unsigned int SCR_WIDTH = 1600;
 const unsigned int SCR_HEIGHT = 800;
@@ -38,6 +67,18 @@ bool hdrKeyPressed = false;
 bool bloom = true;
 bool bloomKeyPressed = false;
 float exposure = 1.0f;
+bool stateOverlay = false;
+bool stateOverlayKeyPressed = false;
+bool occlusionCulling = true;
+bool occlusionKeyPressed = false;
+bool cpuOcclusion = true;
+bool cpuOcclusionKeyPressed = false;
+bool depthPrepass = false;
+bool depthPrepassKeyPressed = false;
+bool testLights = false;
+bool testLightsKeyPressed = false;
+// use the GL 4.6 multi-draw-indirect backend when the driver has it, GL 3.3 otherwise
+const bool preferIndirectDraw = true;
 
 // camera
 Camera camera(glm::vec3(4.0f, 5.0f, 22.0f));
@@ -49,25 +90,95 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// shuts ImGui and GLFW down when main returns. main declares it before everything else, so it goes
+// last: the models, shaders, buffers and queues delete their GL objects in their destructors and
+// need the context to still be current.
+struct ContextShutdown {
+    bool imgui;
+
+    ContextShutdown() : imgui(false) {}
+
+    ~ContextShutdown()
+    {
+        if (imgui) {
+            ImGui_ImplOpenGL3_Shutdown();
+            ImGui_ImplGlfw_Shutdown();
+            ImGui::DestroyContext();
+        }
+        // glfw: terminate, clearing all previously allocated GLFW resources.
+        glfwTerminate();
+    }
+};
 
 int main() {
+    // startup pipeline: model imports and image decodes run on worker threads from the very start,
+    // overlapping window/context creation and shader compilation. the GL thread only uploads.
+    // --------------------------------------------------------------------------------------
+    std::chrono::steady_clock::time_point startupBegin = std::chrono::steady_clock::now();
+    ContextShutdown contextShutdown;
+
+    // load models
+    // -----------
+    // u ucitana ostrva
+    Model ostrvo1;
+    ostrvo1.occluderBudget = 512;   // the islands hide whatever is behind them, see SoftwareOcclusion
+    ostrvo1.LoadAsync("resources/objects/island/island.obj", true);
+
+    //ucitana drva
+    // the trees are the heaviest meshes and get simplified levels for the distance
+    Model drvo1; // MALO DRVO
+    drvo1.generateLods = true;
+    drvo1.LoadAsync("resources/objects/Tree/Tree.obj", true);
+    Model drvo2; // VELIKO DRVO
+    drvo2.generateLods = true;
+    drvo2.LoadAsync("resources/objects/Tree2/Tree.obj", true);
+
+    //ucitavamo cvece i zbunje
+    Model zbun1;
+    zbun1.LoadAsync("resources/objects/Round_Box_Hedge/10453_Round_Box_Hedge_v1_Iteration3.obj", true);
+    Model tulip;
+    tulip.LoadAsync("resources/objects/tulip_flower/12978_tulip_flower_l3.obj", true);
+
+    // ostalo
+    Model bench; //ostrvo1
+    bench.LoadAsync("resources/objects/ConcreteBench/ConcreteBench-L3.obj", true);
+    Model bird;
+    bird.LoadAsync("resources/objects/Bird/12214_Bird_v1max_l3.obj", true);
+    Model lampion;
+    lampion.LoadAsync("resources/objects/svetlo1/streetlight.obj", true);
+
+    // skybox faces are flipped on the y-axis, everything else is loaded as stored
+    // the loader hands out handles before the context exists and decodes in the background
+    vector<std::string> faces;
+    for (const char *face : {"front", "back", "top", "bottom", "left", "right"})
+        faces.push_back(FileSystem::getPath(std::string("resources/textures/skybox/") + face + ".jpg"));
+    unsigned int cubemapTexture = loadCubemap(faces);
+    unsigned int travaTexture = loadTexture(FileSystem::getPath("resources/textures/grass.png").c_str());
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
+    // glfw window creation, a 4.6 context first; drivers without one fail the creation and we retry with 3.3
     // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Heavenly escape", NULL, NULL);
+    GLFWwindow *window = NULL;
+    if (preferIndirectDraw) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Heavenly escape", NULL, NULL);
+    }
+    if (window == NULL) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Heavenly escape", NULL, NULL);
+    }
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
         return -1;
     }
     glfwMakeContextCurrent(window);
@@ -83,22 +194,54 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
-
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
-
+    // with the indirect backend every mesh created from here on goes into the shared buffers
+    if (preferIndirectDraw && indirectDraw().load((GLADloadproc) glfwGetProcAddress))
+        meshArena().enable();
+    // per-frame data streams through a persistently mapped buffer when there is glBufferStorage
+    bool persistentMapping = loadBufferStorage((GLADloadproc) glfwGetProcAddress);
+    std::cout << "Renderer: GL " << GLVersion.major << "." << GLVersion.minor
+              << (meshArena().enabled() ? ", multi-draw-indirect" : ", one draw per mesh")
+              << (persistentMapping ? ", persistent stream buffer" : ", mapped stream buffer") << std::endl;
+
+    // Dear ImGui, only used for the state counter overlay (F1)
+    // -----------------------------
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGui::GetIO().IniFilename = NULL;
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 330 core");
+    contextShutdown.imgui = true;
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    glState().setDepthTest(true);
 
     // Ucitavamo sejdere
     // -------------------------
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    const char *modelVertexShader = meshArena().enabled() ? "resources/shaders/2.model_lighting_indirect.vs" : "resources/shaders/2.model_lighting.vs";
+    // the models pick their variant per mesh (see shader_variants.h), compiled when first drawn
+    ShaderVariants modelShaders(modelVertexShader, "resources/shaders/2.model_lighting.fs",
+                                FEATURE_NO_SPECULAR | FEATURE_HAS_NORMALMAP | FEATURE_IMPOSTOR_FADE, [](Shader &shader) {
+        shader.use();
+        shader.setFloat("material.shininess", 32.0f);
+        LightClusters::bindSamplers(shader);
+    });
+    // depth prepass, the same vertex shader with a depth only fragment shader
+    ShaderVariants depthShaders(modelVertexShader, "resources/shaders/depth_prepass.fs", FEATURE_IMPOSTOR_FADE);
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
     Shader travaShader("resources/shaders/trava.vs", "resources/shaders/trava.fs");
-    Shader hdrShader("resources/shaders/hdr.vs","resources/shaders/hdr.fs");
-    Shader bloomShader("resources/shaders/bloom.vs","resources/shaders/bloom.fs");
+    Shader travaDepthShader("resources/shaders/trava.vs", "resources/shaders/trava_depth.fs");
+    ShaderVariants hdrShaders("resources/shaders/hdr.vs", "resources/shaders/hdr.fs", FEATURE_HDR_OFF | FEATURE_BLOOM_OFF, [](Shader &shader) {
+        shader.use();
+        shader.setInt("hdrBuffer", 0);
+        shader.setInt("bloomBlur", 1);
+    });
+    // bloom down and up the mip chain, the first step down takes the bright pass
+    ShaderVariants bloomDownShaders("resources/shaders/bloom.vs", "resources/shaders/bloom_down.fs", FEATURE_BLOOM_PREFILTER);
+    Shader bloomUpShader("resources/shaders/bloom.vs", "resources/shaders/bloom_up.fs");
+    Shader occlusionShader("resources/shaders/occlusion_box.vs","resources/shaders/occlusion_box.fs");
+    Shader impostorShader("resources/shaders/impostor.vs","resources/shaders/impostor.fs");
+    Shader impostorBakeShader("resources/shaders/impostor_bake.vs","resources/shaders/impostor_bake.fs");
 
 //***********************************************************************************
     float skyboxVertices[] = {
@@ -150,166 +293,277 @@ int main() {
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
+    glState().bindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-    vector<std::string> faces
-            {
-                    FileSystem::getPath("resources/textures/skybox/front.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/back.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/top.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/bottom.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/left.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/right.jpg")
-            };
-
-    unsigned int cubemapTexture = loadCubemap(faces);
 //******************************************************************************************
-    // kvadrat na kojem ce da stoji tekstura travke koja ce da se doda na ostrvo
-    float transparentVertices[] = {
-            // positions         // texture Coords (swapped y coordinates because texture is flipped upside down)
-            0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
-            0.0f, -0.5f,  0.0f,  0.0f,  1.0f,
-            1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
-
-            0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
-            1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
-            1.0f,  0.5f,  0.0f,  1.0f,  0.0f
-    };
+    // trava: ~100k clumps of grass over the tops of the four islands, drawn with one instanced call
+    VegetationField grass;
+    grass.addPatch(glm::vec3(0.0f, -1.0f, 0.0f), 3.0f, 36000, 1);     // centralno ostrvo
+    grass.addPatch(glm::vec3(0.0f, -1.0f, -10.0f), 2.4f, 22000, 2);   // ostrvo pozadi
+    grass.addPatch(glm::vec3(-7.0f, 1.5f, 7.0f), 2.4f, 22000, 3);     // ostrvo napred levo
+    grass.addPatch(glm::vec3(7.0f, -3.5f, 7.0f), 2.4f, 22000, 4);     // ostrvo napred desno
+    grass.Upload();
 
-    //VAO i VBO za kocku koja ce da ima teksturu trave
-    unsigned int transparentVAO, transparentVBO;
-    glGenVertexArrays(1, &transparentVAO);
-    glGenBuffers(1, &transparentVBO);
-    glBindVertexArray(transparentVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
-
-    stbi_set_flip_vertically_on_load(false);
-    unsigned int travaTexture = loadTexture(FileSystem::getPath("resources/textures/grass.png").c_str());
-
-    //Malo pozicije za travke
-    vector<glm::vec3> vegetation
-            {
-                    //centralno ostrvo
-                    glm::vec3(-2.5f,-0.4f,-1.7f),
-                    glm::vec3(-3.2f,-0.4f,-1.6f),
-                    glm::vec3(-3.2f,-0.4f,-2.0f),
-                    glm::vec3(-2.7f,-0.4f,-2.1f),
-
-                    //ostrvo pozadi
-                    glm::vec3(0.1f,-0.4f,-12.5f),
-                    glm::vec3(-0.5f,-0.4f,-12.4f),
-                    glm::vec3(-0.8f,-0.4f,-12.5f),
-
-                    //napred lepo
-                    glm::vec3(-7.1f,2.1f,5.4f),
-                    glm::vec3(-7.6f,2.1f,5.5f),
-                    glm::vec3(-7.5f,2.1f,5.0f),
-                    glm::vec3(-7.98f,2.1f,5.1f),
-            };
 //**********************************************************************************
     // definisanje svega sto treba za rad sa bloom i HDR
     unsigned int hdrFBO;
     glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
+    glState().bindFramebuffer(hdrFBO);
+
+    // one color attachment, the bloom takes its bright parts straight from the scene
+    unsigned int colorBuffer;
+    glGenTextures(1, &colorBuffer);
+    glState().bindTexture(0, GL_TEXTURE_2D, colorBuffer);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // attach texture to framebuffer
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBuffer, 0);
     // create and attach depth buffer (renderbuffer)
     unsigned int rboDepth;
     glGenRenderbuffers(1, &rboDepth);
     glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
     // finally check if framebuffer is complete
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+    glState().bindFramebuffer(0);
 
+    // the bloom's mip chain, half the screen down to a few pixels
+    MipBloom bloomChain(SCR_WIDTH, SCR_HEIGHT);
 
   //*************************************************************************************
 
-    // load models
+    // finish loading the models, waits for their imports and uploads the buffers and textures
     // -----------
-    // u ucitana ostrva
-    Model ostrvo1("resources/objects/island/island.obj", true);
-    ostrvo1.SetShaderTextureNamePrefix("material.");
-
-   //ucitana drva
-    Model drvo1("resources/objects/Tree/Tree.obj", true); // MALO DRVO
-    drvo1.SetShaderTextureNamePrefix("material.");
-    Model drvo2("resources/objects/Tree2/Tree.obj", true); // VELIKO DRVO
-    drvo2.SetShaderTextureNamePrefix("material.");
-
-    //ucitavamo cvece i zbunje
-    Model zbun1("resources/objects/Round_Box_Hedge/10453_Round_Box_Hedge_v1_Iteration3.obj", true);
-    zbun1.SetShaderTextureNamePrefix("material.");
-    Model tulip("resources/objects/tulip_flower/12978_tulip_flower_l3.obj", true);
-    tulip.SetShaderTextureNamePrefix("material.");
-
-    // ostalo
-    Model bench("resources/objects/ConcreteBench/ConcreteBench-L3.obj", true); //ostrvo1
-    bench.SetShaderTextureNamePrefix("material.");
-    Model bird("resources/objects/Bird/12214_Bird_v1max_l3.obj", true);
-    bird.SetShaderTextureNamePrefix("material.");
-    Model lampion("resources/objects/svetlo1/streetlight.obj", true);
-    lampion.SetShaderTextureNamePrefix("material.");
+    for (Model *model : {&ostrvo1, &drvo1, &drvo2, &zbun1, &tulip, &bench, &bird, &lampion}) {
+        model->Upload();
+        model->SetShaderTextureNamePrefix("material.");
+    }
+    std::cout << "Startup: scene uploaded after " << millisecondsSince(startupBegin) << " ms" << std::endl;
 
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
-    bloomShader.use();
-    bloomShader.setInt("image", 0);
-
-    hdrShader.use();
-    hdrShader.setInt("hdrBuffer", 0);
-    hdrShader.setInt("bloomBlur", 1);
+    // wind and grass density don't change, camera and time come from the FrameData block
+    travaShader.use();
+    travaShader.setVec2("windDirection", glm::vec2(0.8f, 0.6f));
+    travaShader.setFloat("windStrength", 0.35f);
+    travaShader.setFloat("densityNear", 6.0f);
+    travaShader.setFloat("densityFar", 30.0f);
+    travaShader.setFloat("minDensity", 0.1f);
+    // the depth prepass has to thin out and sway the grass exactly like the color pass
+    travaDepthShader.use();
+    travaDepthShader.setVec2("windDirection", glm::vec2(0.8f, 0.6f));
+    travaDepthShader.setFloat("windStrength", 0.35f);
+    travaDepthShader.setFloat("densityNear", 6.0f);
+    travaDepthShader.setFloat("densityFar", 30.0f);
+    travaDepthShader.setFloat("minDensity", 0.1f);
+
+
+    // every placement in the park, in a scene hierarchy with one group per island so the frustum test
+    // can drop an island and all of its props at once. The placements that pass are collected each
+    // frame into one list of model matrices per model, so each model still goes out as a single
+    // instanced draw per mesh.
+    // Every island also gets an occlusion query over its whole box. The props are drawn conditionally
+    // on the last frame's result, so an island hidden behind another one skips them on the GPU. The
+    // island itself is always drawn, it is what fills the depth buffer the boxes are tested against.
+    // Before any of that, the islands are rasterized on the CPU as occluders, and placements behind
+    // them are dropped the same frame without being queued at all.
+    // Trees far enough away are drawn as impostors instead, once their atlases are baked.
+    // -----------
+    struct Placements {
+        vector<glm::mat4> transforms;
+        vector<unsigned int> occlusionQueries;  // per transform, 0 for unconditional draws
+        vector<unsigned int> lods;              // per transform, level of detail from its size on screen
+        vector<glm::mat4> impostors;            // placements in or past the impostor fade band
+    };
+    Placements ostrvo1Instances, drvo1Instances, drvo2Instances, zbun1Instances, tulipInstances, benchInstances, birdInstances, lampionInstances;
+    SceneBVH scene;
+    OcclusionQueries occlusion;
+    vector<int> islands;                        // scene group of every island, its occlusion volume has the same index
+    vector<Placements *> sceneObjects;          // per scene object id, the visible placement list of its model
+    vector<Model *> sceneModels;                // per scene object id, its model
+    vector<int> sceneVolumes;                   // per scene object id, the occlusion volume gating it or -1
+    vector<const vector<glm::vec3> *> sceneOccluders;  // per scene object id, its occluder triangles (may be empty)
+    vector<Impostor *> sceneImpostors;          // per scene object id, its model's impostor or null
+    Impostor drvo1Impostor, drvo2Impostor;
+    auto addIsland = [&scene, &occlusion, &islands]() {
+        islands.push_back(scene.addGroup());
+        occlusion.addVolume(Aabb());
+        return islands.back();
+    };
+    auto place = [&](int island, Model &model, Placements &instances, const glm::mat4 &transform) {
+        scene.addObject(island, model.Bounds(), transform);
+        sceneObjects.push_back(&instances);
+        sceneModels.push_back(&model);
+        sceneOccluders.push_back(&model.Occluder());
+        sceneImpostors.push_back(&model == &drvo1 ? &drvo1Impostor : &model == &drvo2 ? &drvo2Impostor : nullptr);
+        sceneVolumes.push_back(&model == &ostrvo1 ? -1 : (int) (std::find(islands.begin(), islands.end(), island) - islands.begin()));
+    };
+    // island one CENTAR
+    int centar = addIsland();
+    place(centar, ostrvo1, ostrvo1Instances, placement(glm::vec3(0.0f,-3.0f,0.0f), glm::vec3(0.5f,0.5f,0.5f)));
+    // Lampion
+    place(centar, lampion, lampionInstances, placement(glm::vec3(-1.2f,-0.95f,1.4f), glm::vec3(1.2f,1.2f,1.2f)));
+    // bench
+    place(centar, bench, benchInstances, placement(glm::vec3(1.0f,-1.0f,-2.5f), glm::vec3(0.02f,0.02f,0.02f), -90.0f, -20.0f));
+    //zbun
+    place(centar, zbun1, zbun1Instances, placement(glm::vec3(1.5f,-1.0f,2.2f), glm::vec3(0.01f,0.01f,0.01f), -90.0f));
+    //Veliko drvo
+    place(centar, drvo2, drvo2Instances, placement(glm::vec3(-2.5f,-1.0f,-1.8f), glm::vec3(1.0f,1.0f,1.0f)));
+    //Bird
+    place(centar, bird, birdInstances, placement(glm::vec3(1.9f,-0.35f,-2.0f), glm::vec3(0.05f,0.05f,0.05f), -90.0f, 50.0f));
+
+    // island two POZADI
+    int pozadi = addIsland();
+    place(pozadi, ostrvo1, ostrvo1Instances, placement(glm::vec3(0.0f,-3.0f,-10.0f), glm::vec3(0.4f,0.5f,0.4f)));
+    //Veliko drvo
+    place(pozadi, drvo2, drvo2Instances, placement(glm::vec3(0.0f,-1.0f,-12.75f), glm::vec3(1.0f,1.0f,1.0f)));
+    //Lampion
+    place(pozadi, lampion, lampionInstances, placement(glm::vec3(-1.9f,-0.95f,-11.5f), glm::vec3(1.0f,1.2f,1.2f)));
+    //ptica desno
+    place(pozadi, bird, birdInstances, placement(glm::vec3(1.75f,-0.93f,-8.5f), glm::vec3(0.05f,0.05f,0.05f), -90.0f, 50.0f));
+    //ptica levo
+    place(pozadi, bird, birdInstances, placement(glm::vec3(-1.5f,-0.82f,-10.0f), glm::vec3(0.05f,0.05f,0.05f), -90.0f, 110.0f));
+    //tulip 1
+    place(pozadi, tulip, tulipInstances, placement(glm::vec3(-1.8f,-0.95f,-8.4f), glm::vec3(0.08f,0.08f,0.08f), -90.0f));
+    //tulip 2
+    place(pozadi, tulip, tulipInstances, placement(glm::vec3(0.6f,-1.0f,-7.7f), glm::vec3(0.08f,0.08f,0.08f), -90.0f));
+    //tulip 3
+    place(pozadi, tulip, tulipInstances, placement(glm::vec3(1.6f,-1.0f,-11.8f), glm::vec3(0.08f,0.08f,0.08f), -90.0f));
+
+    // island three OSTRVO NAPRED LEVO
+    int napredLevo = addIsland();
+    place(napredLevo, ostrvo1, ostrvo1Instances, placement(glm::vec3(-7.0f,-0.5f,7.0f), glm::vec3(0.4f,0.5f,0.4f)));
+    //donje drvo na ostrvu 3
+    place(napredLevo, drvo1, drvo1Instances, placement(glm::vec3(-8.3f,1.5f,8.4f), glm::vec3(1.2f,1.2f,1.2f)));
+    //zbun dole
+    place(napredLevo, zbun1, zbun1Instances, placement(glm::vec3(-7.4f,1.5f,8.9f), glm::vec3(0.01f,0.01f,0.01f), -90.0f));
+    //  tulip dole
+    place(napredLevo, tulip, tulipInstances, placement(glm::vec3(-5.9f,1.5f,8.9f), glm::vec3(0.08f,0.08f,0.08f), -90.0f));
+    //lampion
+    place(napredLevo, lampion, lampionInstances, placement(glm::vec3(-5.45f,1.55f,8.7f), glm::vec3(1.2f,1.2f,1.2f)));
+    //gornje drvo na ostrvu 3
+    place(napredLevo, drvo1, drvo1Instances, placement(glm::vec3(-7.0f,1.5f,5.2f), glm::vec3(1.0f,1.0f,1.0)));
+    //zbun gore
+    place(napredLevo, zbun1, zbun1Instances, placement(glm::vec3(-5.75f,1.5f,4.75f), glm::vec3(0.01f,0.01f,0.01f), -90.0f));
+    //  tulip gore
+    place(napredLevo, tulip, tulipInstances, placement(glm::vec3(-8.0f,1.5f,5.0f), glm::vec3(0.08f,0.08f,0.08f), -90.0f));
+
+    // island four OSTRVO NAPRED DESNO
+    int napredDesno = addIsland();
+    place(napredDesno, ostrvo1, ostrvo1Instances, placement(glm::vec3(7.0f,-5.5f,7.0f), glm::vec3(0.4f,0.5f,0.4f)));
+    //Veliko drvo na ostrvu 4
+    place(napredDesno, drvo2, drvo2Instances, placement(glm::vec3(8.0f,-3.5f,5.0f), glm::vec3(0.8f,0.8f,0.8f)));
+    //zbun gore
+    place(napredDesno, zbun1, zbun1Instances, placement(glm::vec3(6.0f,-3.5f,5.2f), glm::vec3(0.01f,0.01f,0.01f), -90.0f));
+    //malo drvo na ostrvi 4
+    place(napredDesno, drvo1, drvo1Instances, placement(glm::vec3(5.5f,-3.5f,8.6f), glm::vec3(1.0f,1.0f,1.0f)));
+    //zbun dole
+    place(napredDesno, zbun1, zbun1Instances, placement(glm::vec3(6.4f,-3.5f,8.8f), glm::vec3(0.01f,0.01f,0.01f), -90.0f));
+    //lampion
+    place(napredDesno, lampion, lampionInstances, placement(glm::vec3(8.2f,-3.4f,8.8f), glm::vec3(1.2f,1.2f,1.2f)));
+
+    scene.build();
+    for (unsigned int i = 0; i < islands.size(); i++)
+        occlusion.setBounds(i, scene.nodeBounds(islands[i]));
 
     float lin = 0.14f;
     float kvad = 0.07f;
+
+    // uniform blocks shared by all shaders, see uniform_buffer.h
+    UniformBuffer<FrameData> frameBuffer(FRAME_DATA_BINDING);
+    UniformBuffer<LightsData> lightsBuffer(LIGHTS_BINDING);
+
+    LightsData lights = LightsData();
+    //directional
+    lights.dirLight.direction = glm::vec3(-20.0f, -20.0f, 0.0f);
+    lights.dirLight.ambient = glm::vec3(0.06f, 0.06f, 0.06f);
+    lights.dirLight.diffuse = glm::vec3(0.6f, 0.2f, 0.2f);
+    lights.dirLight.specular = glm::vec3(0.1f, 0.1f, 0.1f);
+    // Pointlight's, one above every lampion
+    glm::vec3 pointLightPositions[] = {
+            glm::vec3(-1.05f,2.4f,1.7f),
+            glm::vec3(-1.70f,2.4f,-11.1f),
+            glm::vec3(-5.75f,4.85f,8.95f),
+            glm::vec3(7.7f,-0.4f,8.75f)
+    };
+    vector<PointLight> lampLights;
+    for (const glm::vec3 &position : pointLightPositions)
+    {
+        PointLight light;
+        light.position = position;
+        light.ambient = glm::vec3(0.15f, 0.15f, 0.15f);
+        light.diffuse = glm::vec3(1.5f, 1.5f, 1.1f);
+        light.specular = glm::vec3(0.15f, 0.15f, 0.15f);
+        light.constant = 1.0f;
+        light.linear = lin;
+        light.quadratic = kvad;
+        lampLights.push_back(light);
+    }
+    // the lamps plus 496 small colored lights over the islands, to check that the cost per pixel
+    // stays flat as the light count goes up (L)
+    vector<PointLight> manyLights = lampLights;
+    std::mt19937 lightRandom(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    while (manyLights.size() < 500)
+    {
+        PointLight light;
+        light.position = glm::vec3(-10.0f + 20.0f * unit(lightRandom), -4.0f + 7.0f * unit(lightRandom), -14.0f + 24.0f * unit(lightRandom));
+        glm::vec3 color(unit(lightRandom), unit(lightRandom), unit(lightRandom));
+        light.ambient = color * 0.02f;
+        light.diffuse = color * 0.8f;
+        light.specular = color * 0.2f;
+        light.constant = 1.0f;
+        light.linear = 0.7f;
+        light.quadratic = 1.8f;
+        manyLights.push_back(light);
+    }
+    // point lights are assigned to view space clusters every frame and read from texture buffers
+    LightClusters lightClusters(SCR_WIDTH, SCR_HEIGHT);
+    LightClusters::bindSamplers(impostorShader);
+
+    // everything in the HDR pass goes through the queue, sorted by pass, shader, textures and distance.
+    // its stream buffer stays mapped until the queue is destroyed, before contextShutdown ends the context
+    RenderQueue renderQueue;
+    // GPU time of the scene passes, to compare the frame with and without the depth prepass
+    GpuTimer sceneTimer;
+    // every mesh placement is tested against the frustum before it's queued
+    FrustumCuller culler;
+    vector<unsigned int> visibleObjects;
+    // every model with its placement list, in submission order; models are prepared in parallel,
+    // each with a culler of its own
+    const unsigned int MODEL_COUNT = 8;
+    Model *models[MODEL_COUNT] = {&ostrvo1, &drvo1, &drvo2, &zbun1, &tulip, &bench, &bird, &lampion};
+    Placements *modelInstances[MODEL_COUNT] = {&ostrvo1Instances, &drvo1Instances, &drvo2Instances, &zbun1Instances,
+                                               &tulipInstances, &benchInstances, &birdInstances, &lampionInstances};
+    FrustumCuller modelCullers[MODEL_COUNT];
+    // what one prepare task decided for its share of the visible objects, merged in task order
+    struct PlacementDecision {
+        unsigned int object;
+        unsigned int occlusionQuery;
+        unsigned int lod;
+        bool mesh, impostor;
+    };
+    struct DrawList {
+        vector<PlacementDecision> placements;
+        unsigned int tested, occluded;     // software occlusion tests of the task
+    };
+    vector<DrawList> drawLists;
+    // and, if it's in the frustum, against the island occluders
+    SoftwareOcclusion softwareOcclusion;
+    // level of detail per scene object, remembered between frames
+    LodSelector lodSelector;
+
+    bool firstFrame = true;
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window)) {
@@ -323,381 +577,213 @@ int main() {
         // -----
         processInput(window);
 
+        // stream in textures whose decodes finished since the last frame
+        textureLoader().update();
+
+
+        // the tree atlases, as soon as their textures are in; until then the trees stay meshes at any distance
+        if (!drvo1Impostor.baked() && drvo1Impostor.bakeWhenReady(drvo1, impostorBakeShader))
+            drvo1.impostorFade = drvo1Impostor.fade;
+        if (!drvo2Impostor.baked() && drvo2Impostor.bakeWhenReady(drvo2, impostorBakeShader))
+            drvo2.impostorFade = drvo2Impostor.fade;
 
         // render
         // ------
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        //Sejder koji renderuje ostrvo sa osnovnim bojama
-        ourShader.use();
-
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        glState().bindFramebuffer(hdrFBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        //directional
-        ourShader.setVec3("dirLight.direction", -20.0f, -20.0f, 0.0f);
-        ourShader.setVec3("dirLight.ambient", 0.06, 0.06, 0.06);
-        ourShader.setVec3("dirLight.diffuse",  0.6f,0.2f,0.2);
-        ourShader.setVec3("dirLight.specular", 0.1, 0.1, 0.1);
-
-        // Pointlight's
-            //1
-        ourShader.setVec3("pointLight[0].position", glm::vec3(-1.05f,2.4f,1.7f));
-        ourShader.setVec3("pointLight[0].ambient", glm::vec3(0.15, 0.15, 0.15));
-        ourShader.setVec3("pointLight[0].diffuse", glm::vec3(1.5f,1.5f,1.1f));
-        ourShader.setVec3("pointLight[0].specular", glm::vec3(0.15, 0.15, 0.15));
-        ourShader.setFloat("pointLight[0].constant", 1.0f);
-        ourShader.setFloat("pointLight[0].linear", lin);
-        ourShader.setFloat("pointLight[0].quadratic", kvad);
-            //2
-        ourShader.setVec3("pointLight[1].position", glm::vec3(-1.70f,2.4f,-11.1f));
-        ourShader.setVec3("pointLight[1].ambient", glm::vec3(0.15, 0.15, 0.15));
-        ourShader.setVec3("pointLight[1].diffuse", glm::vec3(1.5f,1.5f,1.1f));
-        ourShader.setVec3("pointLight[1].specular", glm::vec3(0.15, 0.15, 0.15));
-        ourShader.setFloat("pointLight[1].constant", 1.0f);
-        ourShader.setFloat("pointLight[1].linear", lin);
-        ourShader.setFloat("pointLight[1].quadratic", kvad);
-            //3
-        ourShader.setVec3("pointLight[2].position", glm::vec3(-5.75f,4.85f,8.95f));
-        ourShader.setVec3("pointLight[2].ambient", glm::vec3(0.15, 0.15, 0.15));
-        ourShader.setVec3("pointLight[2].diffuse", glm::vec3(1.5f,1.5f,1.1f));
-        ourShader.setVec3("pointLight[2].specular", glm::vec3(0.15, 0.15, 0.15));
-        ourShader.setFloat("pointLight[2].constant", 1.0f);
-        ourShader.setFloat("pointLight[2].linear", lin);
-        ourShader.setFloat("pointLight[2].quadratic", kvad);
-            //4
-        ourShader.setVec3("pointLight[3].position", glm::vec3(7.7f,-0.4f,8.75f));
-        ourShader.setVec3("pointLight[3].ambient", glm::vec3(0.15, 0.15, 0.15));
-        ourShader.setVec3("pointLight[3].diffuse", glm::vec3(1.5f,1.5f,1.1f));
-        ourShader.setVec3("pointLight[3].specular", glm::vec3(0.15, 0.15, 0.15));
-        ourShader.setFloat("pointLight[3].constant", 1.0f);
-        ourShader.setFloat("pointLight[3].linear", lin);
-        ourShader.setFloat("pointLight[3].quadratic", kvad);
-
-
-
-          ourShader.setVec3("viewPosition", camera.Position);
-          ourShader.setFloat("material.shininess", 32.0f);
-        // view/projection transformations
+        // view/projection transformations, shared by every shader through the FrameData block
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
                                                 (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        //Enabling back face culling
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-        //****************************************************************************************
-        // island one CENTAR
-
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(0.0f,-3.0f,0.0f));
-        model = glm::scale(model, glm::vec3(0.5f,0.5f,0.5f));
-        ourShader.setMat4("model", model);
-        ostrvo1.Draw(ourShader);
-
-       // Lampion
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-1.2f,-0.95f,1.4f));
-        model = glm::scale(model, glm::vec3(1.2f,1.2f,1.2f));
-        ourShader.setMat4("model", model);
-        lampion.Draw(ourShader);
-
-        // bench
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(1.0f,-1.0f,-2.5f));
-        model = glm::scale(model, glm::vec3(0.02f,0.02f,0.02f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians((float) -20.0), glm::vec3(0.0f, 0.0f, 1.0f));
-        ourShader.setMat4("model", model);
-        bench.Draw(ourShader);
-
-        //zbun
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(1.5f,-1.0f,2.2f));
-        model = glm::scale(model, glm::vec3(0.01f,0.01f,0.01f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        zbun1.Draw(ourShader);
-
-        //Veliko drvo
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-2.5f,-1.0f,-1.8f));
-        model = glm::scale(model, glm::vec3(1.0f,1.0f,1.0f));
-        ourShader.setMat4("model", model);
-        drvo2.Draw(ourShader);
-
-        //Bird
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(1.9f,-0.35f,-2.0f));
-        model = glm::scale(model, glm::vec3(0.05f,0.05f,0.05f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians((float) 50.0), glm::vec3(0.0f, 0.0f, 1.0f));
-        ourShader.setMat4("model", model);
-        bird.Draw(ourShader);
-
-
-        //***********************************************************************
-        // island two POZADI
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(0.0f,-3.0f,-10.0f));
-        model = glm::scale(model, glm::vec3(0.4f,0.5f,0.4f));
-        ourShader.setMat4("model", model);
-        ostrvo1.Draw(ourShader);
-
-        //Veliko drvo
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(0.0f,-1.0f,-12.75f));
-        model = glm::scale(model, glm::vec3(1.0f,1.0f,1.0f));
-        ourShader.setMat4("model", model);
-        drvo2.Draw(ourShader);
-
-        //Lampion
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-1.9f,-0.95f,-11.5f));
-        model = glm::scale(model, glm::vec3(1.0f,1.2f,1.2f));
-        ourShader.setMat4("model", model);
-        lampion.Draw(ourShader);
-
-        //ptica desno
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(1.75f,-0.93f,-8.5f));
-        model = glm::scale(model, glm::vec3(0.05f,0.05f,0.05f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians((float) 50.0), glm::vec3(0.0f, 0.0f, 1.0f));
-        ourShader.setMat4("model", model);
-        bird.Draw(ourShader);
-
-        //ptica levo
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-1.5f,-0.82f,-10.0f));
-        model = glm::scale(model, glm::vec3(0.05f,0.05f,0.05f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians((float) 110.0), glm::vec3(0.0f, 0.0f, 1.0f));
-        ourShader.setMat4("model", model);
-        bird.Draw(ourShader);
-
-        //tulip 1
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-1.8f,-0.95f,-8.4f));
-        model = glm::scale(model, glm::vec3(0.08f,0.08f,0.08f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        tulip.Draw(ourShader);
-
-
-        //tulip 2
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(0.6f,-1.0f,-7.7f));
-        model = glm::scale(model, glm::vec3(0.08f,0.08f,0.08f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        tulip.Draw(ourShader);
-
-
-        //tulip 3
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(1.6f,-1.0f,-11.8f));
-        model = glm::scale(model, glm::vec3(0.08f,0.08f,0.08f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        tulip.Draw(ourShader);
-
-        //******************************************************************
-        // island three OSTRVO NAPRED LEVO
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-7.0f,-0.5f,7.0f));
-        model = glm::scale(model, glm::vec3(0.4f,0.5f,0.4f));
-        ourShader.setMat4("model", model);
-        ostrvo1.Draw(ourShader);
-
-        //donje drvo na ostrvu 3
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-8.3f,1.5f,8.4f));
-        model = glm::scale(model, glm::vec3(1.2f,1.2f,1.2f));
-        ourShader.setMat4("model", model);
-        drvo1.Draw(ourShader);
-
-        //zbun dole
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-7.4f,1.5f,8.9f));
-        model = glm::scale(model, glm::vec3(0.01f,0.01f,0.01f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        zbun1.Draw(ourShader);
-
-        //  tulip dole
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-5.9f,1.5f,8.9f));
-        model = glm::scale(model, glm::vec3(0.08f,0.08f,0.08f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        tulip.Draw(ourShader);
-
-        //lampion
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-5.45f,1.55f,8.7f));
-        model = glm::scale(model, glm::vec3(1.2f,1.2f,1.2f));
-        ourShader.setMat4("model", model);
-        lampion.Draw(ourShader);
-
-        //gornje drvo na ostrvu 3
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-7.0f,1.5f,5.2f));
-        model = glm::scale(model, glm::vec3(1.0f,1.0f,1.0));
-        ourShader.setMat4("model", model);
-        drvo1.Draw(ourShader);
-
-        //zbun gore
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-5.75f,1.5f,4.75f));
-        model = glm::scale(model, glm::vec3(0.01f,0.01f,0.01f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        zbun1.Draw(ourShader);
-
-      //  tulip gore
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-8.0f,1.5f,5.0f));
-        model = glm::scale(model, glm::vec3(0.08f,0.08f,0.08f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        tulip.Draw(ourShader);
-
-        //***********************************************************
-        // island four OSTRVO NAPRED DESNO
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(7.0f,-5.5f,7.0f));
-        model = glm::scale(model, glm::vec3(0.4f,0.5f,0.4f));
-        ourShader.setMat4("model", model);
-        ostrvo1.Draw(ourShader);
-
-        //Veliko drvo na ostrvu 4
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(8.0f,-3.5f,5.0f));
-        model = glm::scale(model, glm::vec3(0.8f,0.8f,0.8f));
-        ourShader.setMat4("model", model);
-        drvo2.Draw(ourShader);
-
-        //zbun gore
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(6.0f,-3.5f,5.2f));
-        model = glm::scale(model, glm::vec3(0.01f,0.01f,0.01f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        zbun1.Draw(ourShader);
-
-        //malo drvo na ostrvi 4
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(5.5f,-3.5f,8.6f));
-        model = glm::scale(model, glm::vec3(1.0f,1.0f,1.0f));
-        ourShader.setMat4("model", model);
-        drvo1.Draw(ourShader);
-
-        //zbun dole
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(6.4f,-3.5f,8.8f));
-        model = glm::scale(model, glm::vec3(0.01f,0.01f,0.01f));
-        model = glm::rotate(model, glm::radians((float) -90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        zbun1.Draw(ourShader);
-
-        //lampion
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(8.2f,-3.4f,8.8f));
-        model = glm::scale(model, glm::vec3(1.2f,1.2f,1.2f));
-        ourShader.setMat4("model", model);
-        lampion.Draw(ourShader);
-        glDisable(GL_CULL_FACE);
-
-
-        //*************************************************************************
+        FrameData frame = FrameData();
+        frame.projection = projection;
+        frame.view = view;
+        frame.viewPosition = glm::vec4(camera.Position, currentFrame);
+        frameBuffer.update(frame);
+        // the lights only get uploaded again if one of them changed
+        lightsBuffer.update(lights);
+        lightClusters.assign(testLights ? manyLights : lampLights, projection, view, 0.1f, 100.0f);
+        lightClusters.upload();
+
+        renderQueue.begin(camera.Position, 100.0f);
+        renderQueue.setDepthPrepass(depthPrepass);
+        culler.begin(projection * view);
+        occlusion.enabled = occlusionCulling;
+        occlusion.begin(camera.Position, 0.1f);
+
+        // prepare: visibility, occlusion, impostor and LOD choice, then the draw lists of every model.
+        // The heavy parts run on the worker pool, nothing in here touches GL.
+        visibleObjects.clear();
+        scene.cullParallel(culler, visibleObjects);
+        softwareOcclusion.begin(projection * view);
+        if (cpuOcclusion) {
+            for (unsigned int object : visibleObjects)
+                softwareOcclusion.addOccluder(*sceneOccluders[object], scene.transform(object));
+            softwareOcclusion.render();
+        }
+        // every task decides for a contiguous share of the visible objects, into a list of its own
+        drawLists.resize(std::max((size_t) parallelChunks(visibleObjects.size(), 64), drawLists.size()));
+        lodSelector.reserve(scene.objectCount());
+        float fovY = glm::radians(camera.Zoom);
+        parallelFor(visibleObjects.size(), 64, [&](unsigned int chunk, size_t begin, size_t end) {
+            DrawList &list = drawLists[chunk];
+            list.placements.clear();
+            list.tested = list.occluded = 0;
+            for (size_t i = begin; i < end; i++) {
+                unsigned int object = visibleObjects[i];
+                if (cpuOcclusion) {
+                    list.tested++;
+                    if (softwareOcclusion.test(scene.worldBounds(object))) {
+                        list.occluded++;
+                        continue;
+                    }
+                }
+                PlacementDecision decision;
+                decision.object = object;
+                decision.mesh = true;
+                decision.impostor = false;
+                // in the fade band both are drawn and dither into each other, past it only the impostor is
+                const Impostor *impostor = sceneImpostors[object];
+                if (impostor && impostor->baked()) {
+                    float distance = glm::length(glm::vec3(scene.transform(object)[3]) - camera.Position);
+                    decision.impostor = distance > impostor->fade.x;
+                    decision.mesh = distance < impostor->fade.y;
+                }
+                decision.occlusionQuery = sceneVolumes[object] < 0 ? 0 : occlusion.condition(sceneVolumes[object]);
+                decision.lod = 0;
+                if (decision.mesh) {
+                    float size = screenSize(scene.worldBounds(object), camera.Position, fovY);
+                    decision.lod = lodSelector.select(object, size, sceneModels[object]->LodCount());
+                }
+                list.placements.push_back(decision);
+            }
+        });
+        // merged in task order, which keeps the order of the visible objects
+        for (Placements *instances : modelInstances) {
+            instances->transforms.clear();
+            instances->occlusionQueries.clear();
+            instances->lods.clear();
+            instances->impostors.clear();
+        }
+        for (unsigned int chunk = 0; chunk < parallelChunks(visibleObjects.size(), 64); chunk++) {
+            const DrawList &list = drawLists[chunk];
+            softwareOcclusion.count(list.tested, list.occluded);
+            for (const PlacementDecision &decision : list.placements) {
+                Placements &instances = *sceneObjects[decision.object];
+                const glm::mat4 &transform = scene.transform(decision.object);
+                if (decision.impostor)
+                    instances.impostors.push_back(transform);
+                if (decision.mesh) {
+                    instances.transforms.push_back(transform);
+                    instances.occlusionQueries.push_back(decision.occlusionQuery);
+                    instances.lods.push_back(decision.lod);
+                }
+            }
+        }
+        // the meshes of each model against the frustum, grouped into draws, one model per task
+        parallelFor(MODEL_COUNT, 1, [&](unsigned int, size_t begin, size_t end) {
+            for (size_t m = begin; m < end; m++) {
+                modelCullers[m].begin(projection * view);
+                models[m]->Prepare(renderQueue, modelCullers[m], modelInstances[m]->transforms,
+                                   &modelInstances[m]->occlusionQueries, &modelInstances[m]->lods);
+            }
+        });
+        FrustumCuller::Stats meshCulling = {0, 0};
+        for (const FrustumCuller &modelCuller : modelCullers) {
+            meshCulling.tested += modelCuller.stats().tested;
+            meshCulling.visible += modelCuller.stats().visible;
+        }
+
+        // submit: the GL thread streams the prepared draws and queues them
+        for (unsigned int m = 0; m < MODEL_COUNT; m++)
+            models[m]->SubmitPrepared(renderQueue, modelShaders, PASS_OPAQUE, &depthShaders);
+
+        // distant trees, two triangles each. They compute their depth per pixel, so they stay out of the
+        // depth prepass and are tested with GL_LESS against it.
+        drvo1Impostor.prepare(renderQueue, drvo1Instances.impostors);
+        drvo2Impostor.prepare(renderQueue, drvo2Instances.impostors);
+        renderQueue.submit(PASS_ALPHA_TESTED, impostorShader, 0, 0, [&drvo1Impostor, &drvo2Impostor, &impostorShader] {
+            drvo1Impostor.draw(impostorShader);
+            drvo2Impostor.draw(impostorShader);
+        });
+
+        // the island boxes against the depth of the opaque pass, read by next frame's draws
+        renderQueue.submit(PASS_OCCLUSION, occlusionShader, 0, 0, [&occlusion, &occlusionShader, &culler] {
+            occlusion.issue(occlusionShader, culler);
+        });
 
         //**********************************************************************
-        //Palimo sejder i postavljamo travi
-
-        travaShader.use();
-        travaShader.setMat4("projection", projection);
-        travaShader.setMat4("view", view);
-
-        glBindVertexArray(transparentVAO);
-        glBindTexture(GL_TEXTURE_2D, travaTexture);
-        for (unsigned int i = 0; i < vegetation.size(); i++)
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, vegetation[i]);
-            travaShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-        }
+        // trava, after the opaque geometry so its alpha tested fragments fail early against it
+        if (renderQueue.depthPrepass())
+            renderQueue.submit(PASS_DEPTH_ALPHA_TESTED, travaDepthShader, travaTexture, 0, [&grass, travaTexture] {
+                grass.Draw(textureLoader().name(travaTexture));
+            });
+        renderQueue.submit(PASS_ALPHA_TESTED, travaShader, travaTexture, 0, [&grass, travaTexture] {
+            grass.Draw(textureLoader().name(travaTexture));
+        }, renderQueue.depthPrepass());
 
        //*************************************************************************
-        // draw skybox as last
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // skybox last, the sky pass switches to GL_LEQUAL so it passes where the depth buffer is still clear
+        renderQueue.submit(PASS_SKY, skyboxShader, cubemapTexture, 0, [skyboxVAO, cubemapTexture] {
+            glState().bindVertexArray(skyboxVAO);
+            glState().bindTexture(0, GL_TEXTURE_CUBE_MAP, textureLoader().name(cubemapTexture));
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        });
+
+        sceneTimer.begin();
+        renderQueue.execute();
+        sceneTimer.end();
+
+        glState().bindFramebuffer(0);
         //*********************************************
-        //load pingpong
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        bloomShader.use();
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            bloomShader.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);
-
-            renderQuad();
-
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
-        }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // bloom over the mip chain, skipped along with the bloom
+        if (bloom)
+            bloomChain.render(colorBuffer, bloomDownShaders, bloomUpShader, 1.0f, renderQuad);
        // **********************************************
         // load hdr
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        Shader &hdrShader = hdrShaders.get((hdr ? 0u : (uint32_t) FEATURE_HDR_OFF) | (bloom ? 0u : (uint32_t) FEATURE_BLOOM_OFF));
         hdrShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        hdrShader.setBool("hdr", hdr);
-        hdrShader.setBool("bloom", bloom);
+        glState().bindTexture(0, GL_TEXTURE_2D, colorBuffer);
+        glState().bindTexture(1, GL_TEXTURE_2D, bloomChain.texture());
         hdrShader.setFloat("exposure", exposure);
+        // the chain sums its levels, averaged back to about the brightness of the bright pass
+        hdrShader.setFloat("bloomStrength", 1.0f / bloomChain.levelCount());
         renderQuad();
 
+        // the overlay shows the counters of the frame that was just drawn, its own GL calls aren't counted.
+        // the ImGui backend restores everything it touches, so the cache stays valid.
+        glState().endFrame();
+        if (stateOverlay)
+            renderStateOverlay(glState().frameCounters(), scene.stats(), scene.objectCount(), meshCulling, occlusion.issued(),
+                               softwareOcclusion.stats(), renderQueue.meshDrawCalls(), lightClusters.lastStats(),
+                               sceneTimer.milliseconds());
+
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (firstFrame) {
+            glFinish();
+            std::cout << "Startup: time to first frame " << millisecondsSince(startupBegin) << " ms" << std::endl;
+            firstFrame = false;
+        }
     }
 
     //brisanje array i buffera koje ne koristimo vise
-    glDeleteVertexArrays(1, &skyboxVAO);
+    glState().deleteVertexArray(skyboxVAO);
     glDeleteBuffers(1, &skyboxVAO);
-    glDeleteVertexArrays(1, &transparentVAO);
-    glDeleteBuffers(1, &transparentVBO);
 //    glDeleteVertexArrays(1, &cubeVAO);
 //    glDeleteBuffers(1, &cubeVBO);
 
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
-    glfwTerminate();
+    // everything declared in main goes now, with the context still current, then contextShutdown
+    // takes down ImGui and GLFW
     return 0;
 }
 
@@ -717,7 +803,7 @@ void renderQuad()
         // setup plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        glState().bindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -725,9 +811,48 @@ void renderQuad()
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO);
+    glState().bindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+}
+
+// small window in the top left corner with the issued/elided GL state calls and the culling results of the last frame
+void renderStateOverlay(const GLStateCache::Counters &counters, const SceneBVH::Stats &scene, unsigned int sceneObjects,
+                        const FrustumCuller::Stats &culling, unsigned int occlusionQueries, const SoftwareOcclusion::Stats &software,
+                        unsigned int meshDrawCalls, const LightClusters::Stats &lighting, float sceneMilliseconds)
+{
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f));
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    ImGui::Begin("GL state", NULL, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+                                   ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing |
+                                   ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoInputs);
+    ImGui::Text("%-13s %7s %7s", "GL state", "issued", "elided");
+    ImGui::Separator();
+    for (int i = 0; i < GLStateCache::CATEGORY_COUNT; i++)
+        ImGui::Text("%-13s %7u %7u", GLStateCache::categoryName((GLStateCache::Category) i), counters.issued[i], counters.elided[i]);
+    ImGui::Separator();
+    ImGui::Text("%-13s %7u %7u", "total", counters.totalIssued(), counters.totalElided());
+    ImGui::Separator();
+    ImGui::Text("%-13s %7s %7s", "frustum", "visible", "culled");
+    ImGui::Text("%-13s %7u %7u", "objects", scene.objectsVisible, sceneObjects - scene.objectsVisible);
+    ImGui::Text("%-13s %7u %7u", "meshes", culling.visible, culling.culled());
+    ImGui::Text("%-13s %7u", "BVH tests", scene.nodesTested);
+    ImGui::Text("%-13s %7u %s", "occl. queries", occlusionQueries, occlusionCulling ? "" : "(off, O)");
+    ImGui::Text("%-13s %7u %7u %s", "CPU occlusion", software.tested - software.occluded, software.occluded,
+                cpuOcclusion ? "" : "(off, C)");
+    ImGui::Text("%-13s %7u", "occluder tris", software.triangles);
+    ImGui::Text("%-13s %7u %s", "mesh draws", meshDrawCalls, meshArena().enabled() ? "(indirect)" : "");
+    ImGui::Text("%-13s %7u %7u %s", "point lights", lighting.visible, lighting.lights - lighting.visible, testLights ? "(test, L)" : "");
+    ImGui::Text("%-13s %7u", "light indices", lighting.indices);
+    ImGui::Separator();
+    ImGui::Text("%-13s %7.2f %s", "scene GPU ms", sceneMilliseconds, depthPrepass ? "(prepass, P)" : "(no prepass, P)");
+    ImGui::End();
+
+    ImGui::Render();
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -766,6 +891,56 @@ void processInput(GLFWwindow *window) {
         bloomKeyPressed = false;
     }
 
+    if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS && !stateOverlayKeyPressed)
+    {
+        stateOverlay = !stateOverlay;
+        stateOverlayKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_RELEASE)
+    {
+        stateOverlayKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !occlusionKeyPressed)
+    {
+        occlusionCulling = !occlusionCulling;
+        occlusionKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE)
+    {
+        occlusionKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !cpuOcclusionKeyPressed)
+    {
+        cpuOcclusion = !cpuOcclusion;
+        cpuOcclusionKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+    {
+        cpuOcclusionKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !depthPrepassKeyPressed)
+    {
+        depthPrepass = !depthPrepass;
+        depthPrepassKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE)
+    {
+        depthPrepassKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !testLightsKeyPressed)
+    {
+        testLights = !testLights;
+        testLightsKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE)
+    {
+        testLightsKeyPressed = false;
+    }
+
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
     {
         if (exposure > 0.0f)
@@ -811,69 +986,32 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     camera.ProcessMouseScroll(yoffset);
 }
 
-unsigned int loadCubemap(vector<std::string> faces)
+// faces in +X, -X, +Y, -Y, +Z, -Z order, returns a texture loader handle like loadTexture
+unsigned int loadCubemap(vector<std::string> &faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return textureLoader().loadCubemap(faces, true);
 }
 
+// returns a texture loader handle immediately, bind it through textureLoader().name()
 unsigned int loadTexture(char const * path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    return textureLoader().load(path, false, true);
+}
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+// model matrix of a placed object: translate, scale, then rotate around X and Z, in degrees
+glm::mat4 placement(glm::vec3 position, glm::vec3 scale, float rotateX, float rotateZ)
+{
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, position);
+    model = glm::scale(model, scale);
+    if (rotateX != 0.0f)
+        model = glm::rotate(model, glm::radians(rotateX), glm::vec3(1.0f, 0.0f, 0.0f));
+    if (rotateZ != 0.0f)
+        model = glm::rotate(model, glm::radians(rotateZ), glm::vec3(0.0f, 0.0f, 1.0f));
+    return model;
+}
 
-    return textureID;
-}
\ No newline at end of file
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}